@@ -0,0 +1,38 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+// Debug heap allocation counter, built with `make ALLOC_DEBUG=1` and by `make alloc-test`.
+//
+// AllocCounter.cpp replaces the global operator new and counts allocations both per
+// thread and for the whole process. An AllocationCheck at the top of a function
+// reports every call that allocated on the calling thread when it returns; it leaves
+// out the worker pool threads, so run Capture with -j 0 to include the pair meters.
+// tests/alloc_test.cpp uses the process-wide count, which does include them.
+// Allocations made by C code (malloc, fftw_malloc) are not seen.
+
+#ifdef ALLOC_DEBUG
+
+#include <stdio.h>
+
+unsigned long threadAllocationCount();
+unsigned long processAllocationCount();
+
+class AllocationCheck {
+public:
+    explicit AllocationCheck(const char* name) : m_name(name), m_start(threadAllocationCount()) {}
+
+    ~AllocationCheck() {
+        const unsigned long count = threadAllocationCount() - m_start;
+        if (count > 0) {
+            fprintf(stderr, "[ALLOC_DEBUG] %s made %lu heap allocations\n", m_name, count);
+        }
+    }
+
+private:
+    const char* m_name;
+    unsigned long m_start;
+};
+
+#endif // ALLOC_DEBUG
+
+#endif // ALLOCCOUNTER_H
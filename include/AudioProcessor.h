@@ -1,47 +1,83 @@
 #ifndef AUDIOPROCESSOR_H
 #define AUDIOPROCESSOR_H
 
+#include <atomic>
 #include <functional>
 #include <string>
 #include <vector>
-#include <deque>
 #include "DeckLinkAPI.h"
 #include "Config.h"
+#include "channel_spectrum.h"
 #include "eq_processor.h"
+#include "correlation_matrix.h"
 #include "correlator_processor.h"
+#include "loudness_meter.h"
+#include "pcm_deinterleave.h"
+#include "true_peak_meter.h"
+#include "telemetry_aggregator.h"
+#include "vectorscope_decimator.h"
+#include "worker_pool.h"
 
 class AudioProcessor {
 public:
+    // Largest packet accepted: one 23.98 fps frame is 2002 samples at 48 kHz.
+    // Every per-packet buffer is sized for it at initialize().
+    static const unsigned int kMaxPacketFrames = 4096;
+
     AudioProcessor();
-    bool initialize(const BMDConfig& config, std::function<void(const std::string&)> send_ws_message);
-    void processAudioPacket(IDeckLinkAudioInputPacket* audioFrame);
+    bool initialize(const BMDConfig& config, std::function<void(const void*, size_t)> send_ws_binary);
+    // Processes one packet of interleaved PCM in the configured channel count and sample depth.
+    void processAudioPacket(const void* audioFrameBytes, unsigned int sampleFrameCount);
     void startIntegration();
     void stopIntegration();
+    // Changes the monitored L/R pair. Takes effect at the next packet without
+    // resetting the meters of the metered pairs. Returns false, and changes nothing,
+    // when either channel is outside the configured channel count.
+    bool selectPair(unsigned int leftChannel, unsigned int rightChannel);
 
 private:
     BMDConfig m_config;
-    std::function<void(const std::string&)> m_send_ws_message;
+    std::function<void(const void*, size_t)> m_send_ws_binary;
 
     EQProcessor m_eqProcessor;
+    ChannelSpectrum m_channelSpectrum;
     CorrelatorProcessor m_correlatorProcessor;
+    CorrelationMatrix m_correlationMatrix;
+    VectorscopeDecimator m_vectorscopeDecimator;
+
+    // Per-packet scratch, sized once at initialize() so the packet path never allocates.
+    // Each packet is split into one float plane per channel of kMaxPacketFrames samples.
+    PcmDeinterleaver m_deinterleaver;
+    std::vector<float> m_planeBuffer;
+    std::vector<float*> m_planes;
+    unsigned int m_packetFrameCount;
+    std::vector<float> m_maxLevels;
 
-    std::deque<double> m_leftChannelPcm;
-    std::deque<double> m_rightChannelPcm;
-    std::deque<double> m_shortTermLeftChannelPcm;
-    std::deque<double> m_shortTermRightChannelPcm;
-    std::vector<double> m_momentaryLoudnessHistory;
-    std::vector<double> m_shortTermLoudnessHistory;
+    // Meters of the metered stereo pairs, followed by the programme group meter.
+    // The programme meter only runs when the displayed loudness isn't one of the pairs.
+    std::vector<LoudnessMeter> m_meters;
+    std::vector<int> m_meterPairs;
+    size_t m_activeMeterCount;
+    size_t m_displayMeter;
+    TruePeakMeter m_truePeakMeter;
+    WorkerPool m_workerPool;
+    std::function<void(int)> m_meterTask;
 
     bool m_isIntegrating;
 
+    TelemetryAggregator m_telemetry;
+
+    // Requests from the WebSocket thread, applied at the start of the next packet.
+    std::atomic<int> m_pendingIntegration;
+    std::atomic<int> m_pendingPair; // (left << 8) | right, or -1
+    std::atomic<unsigned int> m_channelCount;
+
     static const int kAudioSampleRate = 48000;
-    static const int kWindowSizeInSamples = kAudioSampleRate * 400 / 1000;
-    static const int kShortTermWindowSizeInSamples = kAudioSampleRate * 3;
-    static const int kSlideSizeInSamples = kAudioSampleRate * 100 / 1000;
-    static const size_t kMaxVectorscopeSamples = 512;
 
-    void sendVectorscopeSamples(const std::vector<double>& leftSamples,
-                                const std::vector<double>& rightSamples);
+    enum { kIntegrationUnchanged, kIntegrationStart, kIntegrationStop };
+
+    void applyPendingRequests();
+    void selectDisplayMeter();
 };
 
 #endif // AUDIOPROCESSOR_H
@@ -43,6 +43,22 @@
 
 #include "DeckLinkAPI.h"
 
+// Channel layout measured for programme loudness. Multichannel layouts start at the
+// left channel (-L) and follow the SMPTE order L, R, C, LFE, Ls, Rs[, Lrs, Rrs].
+enum LoudnessLayout
+{
+	kLoudnessLayoutStereo = 0,
+	kLoudnessLayout5_1,
+	kLoudnessLayout7_1
+};
+
+// Bands of the EQ display.
+enum EqBandLayout
+{
+	kEqBandLayoutLog = 0,			// 64 bands evenly spaced in log frequency, 20 Hz - 20 kHz
+	kEqBandLayoutThirdOctave		// 31 ISO third-octave bands
+};
+
 class BMDConfig
 {
 public:
@@ -60,6 +76,16 @@ public:
 	int						m_audioSampleDepth;
 	int						m_leftAudioChannel;
 	int						m_rightAudioChannel;
+	LoudnessLayout			m_loudnessLayout;
+	unsigned int			m_meteredPairs;
+	int						m_meterThreads;
+	unsigned int			m_vectorscopePoints;
+	int						m_telemetryRate;
+	int						m_eqOverlap;
+	EqBandLayout			m_eqBandLayout;
+	int						m_channelSpectrumRate;
+	int						m_correlationTime;
+	int						m_correlationMatrixRate;
 
 	int						m_maxFrames;
 
@@ -69,11 +95,20 @@ public:
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
+	const char*				m_telemetryShmName;
+	int						m_serverPort;
+	const char*				m_webRoot;
 
 	IDeckLink* GetSelectedDeckLink(void);
 	IDeckLinkDisplayMode* GetSelectedDeckLinkDisplayMode(IDeckLink* deckLink);
 
+	static bool GetPixelFormat(int index, BMDPixelFormat& pixelFormat);
 	static const char* GetPixelFormatName(BMDPixelFormat pixelFormat);
+	static const char* GetLoudnessLayoutName(LoudnessLayout layout);
+	static bool ParseLoudnessLayout(const char* name, LoudnessLayout& layout);
+	static int GetLoudnessLayoutChannelCount(LoudnessLayout layout);
+	static const char* GetEqBandLayoutName(EqBandLayout layout);
+	static bool ParseEqBandLayout(const char* name, EqBandLayout& layout);
 
 private:
 	char*					m_deckLinkName;
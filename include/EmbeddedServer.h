@@ -0,0 +1,64 @@
+#ifndef EMBEDDEDSERVER_H
+#define EMBEDDEDSERVER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <set>
+#include <string>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+// Built-in HTTP/WebSocket server for running Capture without the Node relay.
+//
+// Serves the pages in the web root and pushes telemetry straight to the connected
+// browsers. Every connection has its own send buffer; a connection holding more
+// than the backpressure limit skips binary telemetry until it drains, so one slow
+// browser never delays the others or the capture side. Text messages (settings,
+// integration state, signal info) are always delivered.
+class EmbeddedServer {
+public:
+    typedef websocketpp::server<websocketpp::config::asio> server;
+    // Called on the server thread with each text message received from a browser.
+    typedef std::function<void(const std::string&)> MessageHandler;
+    // Handles /api/ requests: gets the method, resource and body, returns the JSON
+    // response body and sets status (HTTP status code).
+    typedef std::function<std::string(const std::string&, const std::string&, const std::string&, int&)> ApiHandler;
+
+    EmbeddedServer();
+    ~EmbeddedServer();
+
+    bool start(uint16_t port, const std::string& webRoot, MessageHandler onMessage, ApiHandler onApi);
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // Sends one message to every connected browser. Safe to call from any thread.
+    void broadcast(const std::string& payload, bool binary);
+
+private:
+    typedef std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> ConnectionSet;
+
+    static void* threadFunc(void* arg);
+    void onHttp(websocketpp::connection_hdl hdl);
+    void onOpen(websocketpp::connection_hdl hdl);
+    void onClose(websocketpp::connection_hdl hdl);
+    void onMessage(websocketpp::connection_hdl hdl, server::message_ptr msg);
+    bool readFile(const std::string& resource, std::string& body, std::string& contentType);
+
+    static const size_t kMaxBufferedBytes = 512 * 1024;
+
+    server m_server;
+    pthread_t m_thread;
+    std::atomic<bool> m_running;
+    std::string m_webRoot;
+    MessageHandler m_onMessage;
+    ApiHandler m_onApi;
+
+    std::mutex m_connectionsMutex;
+    ConnectionSet m_connections;
+};
+
+#endif // EMBEDDEDSERVER_H
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <semaphore.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue of raw audio packets.
+//
+// The DeckLink callback thread copies each packet into a preallocated slot and
+// returns straight away; the audio DSP thread drains the slots in order. Nothing is
+// allocated or locked on the producer side: slot ownership moves with two atomic
+// indices and the consumer sleeps on a semaphore. When the consumer falls behind,
+// the newest packet is dropped and counted instead of stalling capture.
+class AudioPacketRing {
+public:
+    struct Packet {
+        std::vector<uint8_t> bytes;
+        unsigned int frameCount;
+    };
+
+    AudioPacketRing() : m_mask(0), m_frameBytes(0), m_maxFrames(0), m_head(0), m_tail(0),
+                        m_overruns(0), m_stopping(false) {
+        sem_init(&m_available, 0, 0);
+    }
+
+    ~AudioPacketRing() {
+        sem_destroy(&m_available);
+    }
+
+    // Non-copyable
+    AudioPacketRing(const AudioPacketRing&) = delete;
+    AudioPacketRing& operator=(const AudioPacketRing&) = delete;
+
+    // slotCount is rounded up to a power of two. Must be called while neither thread
+    // runs: before they start, or after stop() to resize for a new audio format.
+    void initialize(unsigned int slotCount, unsigned int frameBytes, unsigned int maxFrames) {
+        unsigned int size = 1;
+        while (size < slotCount) size <<= 1;
+        m_slots.assign(size, Packet());
+        for (Packet& slot : m_slots) {
+            slot.bytes.resize((size_t)frameBytes * maxFrames);
+            slot.frameCount = 0;
+        }
+        m_mask = size - 1;
+        m_frameBytes = frameBytes;
+        m_maxFrames = maxFrames;
+        m_head = 0;
+        m_tail = 0;
+        m_overruns = 0;
+        m_stopping = false;
+        // Discard wake-ups left over from the previous run.
+        while (sem_trywait(&m_available) == 0) {
+        }
+    }
+
+    // Producer: copies one packet. Returns false, and counts an overrun, when every
+    // slot is still waiting for the consumer or the packet doesn't fit a slot.
+    bool push(const void* bytes, unsigned int frameCount) {
+        const unsigned int head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask || frameCount > m_maxFrames) {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Packet& slot = m_slots[head & m_mask];
+        memcpy(slot.bytes.data(), bytes, (size_t)frameCount * m_frameBytes);
+        slot.frameCount = frameCount;
+        m_head.store(head + 1, std::memory_order_release);
+        sem_post(&m_available);
+        return true;
+    }
+
+    // Consumer: blocks until a packet is queued. Returns NULL once stop() is called.
+    // The packet stays valid until pop().
+    const Packet* wait() {
+        while (sem_wait(&m_available) != 0) {
+            // Interrupted by a signal; keep waiting.
+        }
+        if (m_stopping.load(std::memory_order_acquire)) {
+            return NULL;
+        }
+        return &m_slots[m_tail.load(std::memory_order_relaxed) & m_mask];
+    }
+
+    void pop() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Wakes the consumer and makes wait() return NULL.
+    void stop() {
+        m_stopping.store(true, std::memory_order_release);
+        sem_post(&m_available);
+    }
+
+    unsigned long overruns() const {
+        return m_overruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<Packet> m_slots;
+    unsigned int m_mask;
+    unsigned int m_frameBytes;
+    unsigned int m_maxFrames;
+
+    std::atomic<unsigned int> m_head;
+    std::atomic<unsigned int> m_tail;
+    std::atomic<unsigned long> m_overruns;
+    std::atomic<bool> m_stopping;
+    sem_t m_available;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Maps a power spectrum onto display bands with a sparse weight matrix built once.
+//
+// Each band is a frequency range given by consecutive edges. A bin counts towards a
+// band by the fraction of its width that falls inside the range, so bands narrower
+// than a bin still read the bin under them. By default the weights are normalised per
+// band, so a band reads the mean power of its bins; summed bands read the total power
+// in their range instead, so a tone reads the same in any band. The weights carry an
+// optional per-bin amplitude gain (the A-weighting curve) squared, so a band level is
+// a single dot product over its bins.
+class BandLayout {
+public:
+    // edges holds bandCount + 1 increasing frequencies. binGains holds an amplitude
+    // gain per bin (binCount entries) or is null.
+    void build(const std::vector<double>& edges, int binCount, double binWidth, const float* binGains,
+               bool summed = false) {
+        m_entries.clear();
+        m_bandStart.assign(1, 0);
+
+        for (size_t band = 0; band + 1 < edges.size(); ++band) {
+            const double low = edges[band];
+            const double high = edges[band + 1];
+            const size_t first = m_entries.size();
+            double total = 0.0;
+
+            // Bin k covers [(k - 0.5), (k + 0.5)) * binWidth.
+            const int firstBin = std::max(0, (int)std::floor(low / binWidth + 0.5));
+            const int lastBin = std::min(binCount - 1, (int)std::floor(high / binWidth + 0.5));
+            for (int bin = firstBin; bin <= lastBin; ++bin) {
+                const double overlap = std::min(high, (bin + 0.5) * binWidth) - std::max(low, (bin - 0.5) * binWidth);
+                if (overlap <= 0.0) continue;
+                Entry entry;
+                entry.bin = bin;
+                entry.weight = (float)(overlap / binWidth);
+                m_entries.push_back(entry);
+                total += entry.weight;
+            }
+
+            for (size_t i = first; i < m_entries.size(); ++i) {
+                const float gain = binGains ? binGains[m_entries[i].bin] : 1.0f;
+                const float fraction = summed ? m_entries[i].weight : (float)(m_entries[i].weight / total);
+                m_entries[i].weight = fraction * gain * gain;
+            }
+            m_bandStart.push_back((int)m_entries.size());
+        }
+    }
+
+    int bandCount() const {
+        return (int)m_bandStart.size() - 1;
+    }
+
+    // Band levels in dB from a power spectrum; floorDb for bands without energy.
+    void apply(const float* power, float* bands, float floorDb) const {
+        const float floorPower = std::pow(10.0f, floorDb / 10.0f);
+        for (int band = 0; band < bandCount(); ++band) {
+            float sum = 0.0f;
+            for (int i = m_bandStart[band]; i < m_bandStart[band + 1]; ++i) {
+                sum += m_entries[i].weight * power[m_entries[i].bin];
+            }
+            bands[band] = (sum > floorPower) ? 10.0f * std::log10(sum) : floorDb;
+        }
+    }
+
+    // Edges of count bands spaced evenly in log frequency.
+    static std::vector<double> logEdges(int count, double low, double high) {
+        std::vector<double> edges(count + 1);
+        const double logLow = std::log(low);
+        const double logRange = std::log(high) - logLow;
+        for (int i = 0; i <= count; ++i) {
+            edges[i] = std::exp(logLow + logRange * i / count);
+        }
+        return edges;
+    }
+
+    // Edges of the 31 ISO 266 third-octave bands, 20 Hz to 20 kHz (base-2 midbands).
+    static std::vector<double> thirdOctaveEdges() {
+        std::vector<double> edges;
+        for (int band = -17; band <= 14; ++band) {
+            edges.push_back(1000.0 * std::pow(2.0, (band - 0.5) / 3.0));
+        }
+        return edges;
+    }
+
+private:
+    struct Entry {
+        int bin;
+        float weight;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<int> m_bandStart;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include <fftw3.h>
+#include "band_layout.h"
+#include "fftw_wisdom.h"
+#include "ring_buffer.h"
+
+// Third-octave spectrum of every input channel for QC, published at a fixed rate.
+//
+// All channels go through one batched r2c plan (fftwf_plan_many_dft_r2c) over a
+// contiguous block of per-channel windows, so the whole set costs one planner call,
+// one execute and one window pass instead of a full analyser per channel. Bands are
+// unweighted and summed, in dB relative to a full-scale sine, so a tone reads its
+// level in whichever band it falls. Bands below about 200 Hz are narrower than a
+// 23.4 Hz bin and read their share of it. Levels are kept as int16 hundredths of a dB.
+class ChannelSpectrum {
+public:
+    ChannelSpectrum() : m_plan(nullptr), m_in(nullptr), m_out(nullptr), m_channelCount(0),
+                        m_interval(0), m_pendingFrames(0), m_powerScale(0.0f) {}
+
+    ~ChannelSpectrum() {
+        if (m_plan) fftwf_destroy_plan(m_plan);
+        if (m_in) fftwf_free(m_in);
+        if (m_out) fftwf_free(m_out);
+    }
+
+    // Non-copyable
+    ChannelSpectrum(const ChannelSpectrum&) = delete;
+    ChannelSpectrum& operator=(const ChannelSpectrum&) = delete;
+
+    // updatesPerSecond: 0 disables the analysis.
+    void initialize(int channelCount, int sampleRate, int updatesPerSecond, unsigned int maxPacketFrames) {
+        m_interval = (updatesPerSecond > 0) ? sampleRate / updatesPerSecond : 0;
+        m_pendingFrames = 0;
+        if (m_interval == 0) {
+            return;
+        }
+
+        if (channelCount != m_channelCount || !m_plan) {
+            if (m_plan) fftwf_destroy_plan(m_plan);
+            if (m_in) fftwf_free(m_in);
+            if (m_out) fftwf_free(m_out);
+            m_channelCount = channelCount;
+
+            // Channel ch's window starts at m_in + ch * kFftSize, its bins at m_out + ch * kBinCount.
+            m_in = (float*) fftwf_malloc(sizeof(float) * kFftSize * channelCount);
+            m_out = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * kBinCount * channelCount);
+            const int size = kFftSize;
+            loadFftwWisdom();
+            m_plan = fftwf_plan_many_dft_r2c(1, &size, channelCount,
+                                             m_in, nullptr, 1, kFftSize,
+                                             m_out, nullptr, 1, kBinCount, FFTW_MEASURE);
+            saveFftwWisdom();
+        }
+
+        // Full-scale sine = 0 dB: its one-sided bin powers sum to N * sum(w^2) / 4.
+        m_window.resize(kFftSize);
+        double windowPower = 0.0;
+        for (int i = 0; i < kFftSize; ++i) {
+            m_window[i] = 0.5 * (1 - std::cos(2 * M_PI * i / (kFftSize - 1)));
+            windowPower += (double)m_window[i] * m_window[i];
+        }
+        m_powerScale = (float)(4.0 / (kFftSize * windowPower));
+
+        m_layout.build(BandLayout::thirdOctaveEdges(), kBinCount, (double)sampleRate / kFftSize, nullptr, true);
+        m_power.resize(kBinCount);
+        m_bands.resize(m_layout.bandCount());
+        m_levels.assign((size_t)m_layout.bandCount() * channelCount, kFloor);
+
+        // Room for a window plus the largest packet; the oldest samples fall off.
+        m_history.resize(channelCount);
+        for (RingBuffer<float>& history : m_history) {
+            history.initialize(kFftSize + maxPacketFrames);
+        }
+    }
+
+    bool enabled() const {
+        return m_interval > 0;
+    }
+
+    // Adds a packet of per-channel planes. Returns true when a new set of levels is
+    // available from levels().
+    bool process(const float* const* planes, unsigned int frameCount) {
+        if (!enabled()) return false;
+
+        for (int ch = 0; ch < m_channelCount; ++ch) {
+            m_history[ch].write(planes[ch], frameCount);
+        }
+        m_pendingFrames += frameCount;
+        if (m_pendingFrames < m_interval || m_history[0].size() < (size_t)kFftSize) {
+            return false;
+        }
+        m_pendingFrames = 0;
+
+        // Newest window of every channel, windowed into the batch input.
+        for (int ch = 0; ch < m_channelCount; ++ch) {
+            const RingBuffer<float>& history = m_history[ch];
+            const RingBuffer<float>::View view = history.view(history.size() - kFftSize, kFftSize);
+            float* in = m_in + (size_t)ch * kFftSize;
+            for (size_t i = 0; i < view.first.size; ++i) {
+                in[i] = view.first.data[i] * m_window[i];
+            }
+            for (size_t i = 0; i < view.second.size; ++i) {
+                in[view.first.size + i] = view.second.data[i] * m_window[view.first.size + i];
+            }
+        }
+
+        fftwf_execute(m_plan);
+
+        const int bandCount = m_layout.bandCount();
+        for (int ch = 0; ch < m_channelCount; ++ch) {
+            const fftwf_complex* bins = m_out + (size_t)ch * kBinCount;
+            for (int i = 0; i < kBinCount; ++i) {
+                m_power[i] = (bins[i][0] * bins[i][0] + bins[i][1] * bins[i][1]) * m_powerScale;
+            }
+            m_layout.apply(m_power.data(), m_bands.data(), kFloorDb);
+            int16_t* levels = &m_levels[(size_t)ch * bandCount];
+            for (int band = 0; band < bandCount; ++band) {
+                levels[band] = (int16_t)std::lrint(std::clamp(m_bands[band], kFloorDb, kCeilingDb) * 100.0f);
+            }
+        }
+        return true;
+    }
+
+    int bandCount() const {
+        return m_layout.bandCount();
+    }
+
+    // Band levels in 0.01 dB, channel-major: bandCount() values per channel.
+    const std::vector<int16_t>& levels() const {
+        return m_levels;
+    }
+
+private:
+    static const int kFftSize = 2048;
+    static const int kBinCount = kFftSize / 2 + 1;
+    static constexpr float kFloorDb = -100.0f;
+    static constexpr float kCeilingDb = 20.0f;
+    static constexpr int16_t kFloor = -10000;
+
+    fftwf_plan m_plan;
+    float* m_in;
+    fftwf_complex* m_out;
+    int m_channelCount;
+    unsigned int m_interval;
+    unsigned int m_pendingFrames;
+    float m_powerScale;
+
+    std::vector<float> m_window;
+    std::vector<RingBuffer<float>> m_history;
+    BandLayout m_layout;
+    std::vector<float> m_power;
+    std::vector<float> m_bands;
+    std::vector<int16_t> m_levels;
+};
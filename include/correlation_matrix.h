@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Phase correlation between every pair of input channels, for spotting polarity-flipped
+// (near -1) and duplicated (near +1) channels.
+//
+// Sums of x[i] * x[j] for all i <= j accumulate over each publish interval, and the
+// matrix is published as sum(ij) / sqrt(sum(ii) * sum(jj)) for i < j. The packet is
+// walked in tiles that keep every channel's slice in L1, and each tile row multiplies
+// one channel against four others per pass, so a channel is loaded once per four pairs
+// instead of once per pair.
+class CorrelationMatrix {
+public:
+    CorrelationMatrix() : m_channelCount(0), m_interval(0), m_pendingFrames(0) {}
+
+    // updatesPerSecond: 0 disables the analysis.
+    void initialize(int channelCount, int sampleRate, int updatesPerSecond) {
+        m_channelCount = channelCount;
+        m_interval = (updatesPerSecond > 0) ? sampleRate / updatesPerSecond : 0;
+        m_pendingFrames = 0;
+        m_sums.assign((size_t)channelCount * channelCount, 0.0);
+        m_tileSums.assign((size_t)channelCount * channelCount, 0.0f);
+        m_values.assign((size_t)channelCount * (channelCount - 1) / 2, 0.0f);
+    }
+
+    bool enabled() const {
+        return m_interval > 0;
+    }
+
+    // Adds a packet of per-channel planes. Returns true when a new matrix is available
+    // from values().
+    bool process(const float* const* planes, unsigned int frameCount) {
+        if (!enabled()) return false;
+
+        for (unsigned int start = 0; start < frameCount; start += kTileFrames) {
+            const int count = (int)std::min<unsigned int>(kTileFrames, frameCount - start);
+            accumulateTile(planes, start, count);
+        }
+
+        m_pendingFrames += frameCount;
+        if (m_pendingFrames < m_interval) {
+            return false;
+        }
+        // The sums cover the whole interval; dividing by its length gives the mean
+        // square the silence gate is defined on, independent of the update rate.
+        const double frames = m_pendingFrames;
+        m_pendingFrames = 0;
+
+        const int n = m_channelCount;
+        size_t index = 0;
+        for (int i = 0; i < n; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                const double denominator = std::sqrt(m_sums[i * n + i] * m_sums[j * n + j]);
+                m_values[index++] = (denominator < kSilence * frames) ? 0.0f
+                    : (float)std::clamp(m_sums[i * n + j] / denominator, -1.0, 1.0);
+            }
+        }
+        std::fill(m_sums.begin(), m_sums.end(), 0.0);
+        return true;
+    }
+
+    // Upper triangle, row by row: (0,1), (0,2) ... (0,n-1), (1,2) ... (n-2,n-1).
+    const std::vector<float>& values() const {
+        return m_values;
+    }
+
+private:
+    // 256 frames of 16 channels is 16 KiB of input per tile.
+    static constexpr unsigned int kTileFrames = 256;
+    // Geometric mean of the two channels' mean squares below which a pair counts as
+    // silent (about -100 dBFS).
+    static constexpr double kSilence = 1e-10;
+
+    // Tile sums stay in float (at most kTileFrames terms) and are folded into the
+    // double interval sums once per tile.
+    void accumulateTile(const float* const* planes, unsigned int start, int count) {
+        const int n = m_channelCount;
+        for (int i = 0; i < n; ++i) {
+            const float* x = planes[i] + start;
+            int j = i;
+            for (; j + 4 <= n; j += 4) {
+                dot4(x, planes[j] + start, planes[j + 1] + start, planes[j + 2] + start, planes[j + 3] + start,
+                     count, &m_tileSums[i * n + j]);
+            }
+            for (; j < n; ++j) {
+                const float* y = planes[j] + start;
+                float sum = 0.0f;
+                for (int k = 0; k < count; ++k) {
+                    sum += x[k] * y[k];
+                }
+                m_tileSums[i * n + j] = sum;
+            }
+            for (j = i; j < n; ++j) {
+                m_sums[i * n + j] += m_tileSums[i * n + j];
+            }
+        }
+    }
+
+    // out[c] = dot(x, yc) for four channels, reading x once.
+    static void dot4(const float* x, const float* y0, const float* y1, const float* y2, const float* y3,
+                     int count, float* out) {
+        int k = 0;
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+#if defined(__SSE2__)
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for (; k + 4 <= count; k += 4) {
+            const __m128 xv = _mm_loadu_ps(x + k);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(xv, _mm_loadu_ps(y0 + k)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(xv, _mm_loadu_ps(y1 + k)));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(xv, _mm_loadu_ps(y2 + k)));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(xv, _mm_loadu_ps(y3 + k)));
+        }
+        // Transpose-and-add leaves the four horizontal sums in one register.
+        _MM_TRANSPOSE4_PS(acc0, acc1, acc2, acc3);
+        _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+#endif
+        for (; k < count; ++k) {
+            out[0] += x[k] * y0[k];
+            out[1] += x[k] * y1[k];
+            out[2] += x[k] * y2[k];
+            out[3] += x[k] * y3[k];
+        }
+    }
+
+    int m_channelCount;
+    unsigned int m_interval;
+    unsigned int m_pendingFrames;
+    std::vector<double> m_sums;     // n x n, upper triangle used
+    std::vector<float> m_tileSums;  // n x n, upper triangle used
+    std::vector<float> m_values;
+};
@@ -1,41 +1,119 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
 #include <cmath>
-#include <numeric>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+// Streaming phase correlation meter of one stereo pair.
+//
+// Keeps exponentially weighted running sums of L*R, L*L and R*R with a configurable
+// time constant and reports
+//   sum(L*R) / sqrt(sum(L^2) * sum(R^2))
+// between -1.0 (perfectly out of phase) and +1.0 (perfectly in phase); 0.0 when the
+// channels are uncorrelated or silent. The value no longer depends on packet size.
+//
+// The recursion is applied a block at a time. Inside a block every sample's weight
+// comes from a precomputed table, so the inner loop is a weighted dot product with no
+// serial dependency, and the running sums decay once per block.
 class CorrelatorProcessor {
 public:
-    CorrelatorProcessor() = default;
-
-    // Processes a block of stereo audio samples and returns the correlation.
-    // Correlation is a value between -1.0 (perfectly out of phase) and +1.0 (perfectly in phase).
-    // 0.0 indicates no correlation.
-    //
-    // The formula used is the Pearson correlation coefficient:
-    //   sum(L[i] * R[i]) / (sqrt(sum(L[i]^2)) * sqrt(sum(R[i]^2)))
-    // for N samples.
+    CorrelatorProcessor() : m_sum_l_r(0.0), m_sum_l_sq(0.0), m_sum_r_sq(0.0) {}
+
+    void initialize(int sampleRate, int timeConstantMs) {
+        const double decay = std::exp(-1000.0 / ((double)timeConstantMs * sampleRate));
+        m_weights.resize(kBlockSize);
+        m_blockDecay.resize(kBlockSize + 1);
+        for (int i = 0; i < kBlockSize; ++i) {
+            m_weights[i] = (float)((1.0 - decay) * std::pow(decay, kBlockSize - 1 - i));
+        }
+        for (int n = 0; n <= kBlockSize; ++n) {
+            m_blockDecay[n] = std::pow(decay, n);
+        }
+        reset();
+    }
+
+    // Forgets the history, e.g. when another pair is selected.
+    void reset() {
+        m_sum_l_r = 0.0;
+        m_sum_l_sq = 0.0;
+        m_sum_r_sq = 0.0;
+    }
+
+    // Adds a block of stereo samples and returns the correlation so far.
     float process(const float* left_channel, const float* right_channel, int samples) {
-        if (samples == 0) {
-            return 0.0f;
+        if (m_weights.empty()) {
+            return 0.0f; // Not initialized
         }
 
-        double sum_l_r = 0.0;
-        double sum_l_sq = 0.0;
-        double sum_r_sq = 0.0;
+        for (int start = 0; start < samples; start += kBlockSize) {
+            const int count = std::min(kBlockSize, samples - start);
+            // The last count weights give a short block its samples' ages.
+            const float* weights = m_weights.data() + (kBlockSize - count);
+            float sum_l_r, sum_l_sq, sum_r_sq;
+            weightedSums(left_channel + start, right_channel + start, weights, count, sum_l_r, sum_l_sq, sum_r_sq);
+
+            const double decay = m_blockDecay[count];
+            m_sum_l_r = m_sum_l_r * decay + sum_l_r;
+            m_sum_l_sq = m_sum_l_sq * decay + sum_l_sq;
+            m_sum_r_sq = m_sum_r_sq * decay + sum_r_sq;
+        }
 
-        for (int i = 0; i < samples; ++i) {
-            sum_l_r += left_channel[i] * right_channel[i];
-            sum_l_sq += left_channel[i] * left_channel[i];
-            sum_r_sq += right_channel[i] * right_channel[i];
+        const double denominator = std::sqrt(m_sum_l_sq * m_sum_r_sq);
+        if (denominator < kSilence) {
+            return 0.0f;
         }
+        return static_cast<float>(std::clamp(m_sum_l_r / denominator, -1.0, 1.0));
+    }
 
-        double denominator = std::sqrt(sum_l_sq) * std::sqrt(sum_r_sq);
+private:
+    static constexpr int kBlockSize = 64;
+    // Mean square product below which both channels count as silent (about -100 dBFS).
+    static constexpr double kSilence = 1e-10;
 
-        if (denominator == 0.0) {
-            return 0.0f; // Or 1.0f if both channels are silent, depending on desired behavior
+    static void weightedSums(const float* left, const float* right, const float* weights, int count,
+                             float& sum_l_r, float& sum_l_sq, float& sum_r_sq) {
+        int i = 0;
+        sum_l_r = sum_l_sq = sum_r_sq = 0.0f;
+#if defined(__SSE2__)
+        __m128 acc_l_r = _mm_setzero_ps();
+        __m128 acc_l_sq = _mm_setzero_ps();
+        __m128 acc_r_sq = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            const __m128 l = _mm_loadu_ps(left + i);
+            const __m128 r = _mm_loadu_ps(right + i);
+            const __m128 w = _mm_loadu_ps(weights + i);
+            const __m128 wl = _mm_mul_ps(w, l);
+            acc_l_r = _mm_add_ps(acc_l_r, _mm_mul_ps(wl, r));
+            acc_l_sq = _mm_add_ps(acc_l_sq, _mm_mul_ps(wl, l));
+            acc_r_sq = _mm_add_ps(acc_r_sq, _mm_mul_ps(_mm_mul_ps(w, r), r));
+        }
+        sum_l_r = horizontalSum(acc_l_r);
+        sum_l_sq = horizontalSum(acc_l_sq);
+        sum_r_sq = horizontalSum(acc_r_sq);
+#endif
+        for (; i < count; ++i) {
+            const float wl = weights[i] * left[i];
+            sum_l_r += wl * right[i];
+            sum_l_sq += wl * left[i];
+            sum_r_sq += weights[i] * right[i] * right[i];
         }
+    }
 
-        return static_cast<float>(sum_l_r / denominator);
+#if defined(__SSE2__)
+    static float horizontalSum(__m128 v) {
+        __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
     }
+#endif
+
+    std::vector<float> m_weights;
+    std::vector<double> m_blockDecay;
+    double m_sum_l_r;
+    double m_sum_l_sq;
+    double m_sum_r_sq;
 };
@@ -1,139 +1,266 @@
 #pragma once
 
 #include <vector>
-#include <string>
-#include <sstream>
-#include <functional>
+#include <algorithm>
 #include <cmath>
 #include <fftw3.h>
+#include "band_layout.h"
+#include "fftw_wisdom.h"
+#include "ring_buffer.h"
 
+// Stereo spectrum for the EQ display, analysed at two resolutions.
+//
+// Bands above kCrossoverHz come from a 2048-point FFT at 48 kHz (23.4 Hz bins). The
+// bands below it come from the same size FFT run on the signal low-passed and
+// decimated by kDecimation (2.9 Hz bins), which resolves the bass octaves for the
+// cost of a short FIR and an occasional small transform instead of one 16k FFT.
 class EQProcessor {
 public:
-    EQProcessor() : g_fft_plan_l(nullptr), g_fft_plan_r(nullptr),
-                    g_fft_in_l(nullptr), g_fft_in_r(nullptr),
-                    g_fft_out_l(nullptr), g_fft_out_r(nullptr) {}
+    EQProcessor() : m_decimPhase(0), m_lowBandCount(0) {}
 
     ~EQProcessor() {
-        if (g_fft_plan_l) fftw_destroy_plan(g_fft_plan_l);
-        if (g_fft_plan_r) fftw_destroy_plan(g_fft_plan_r);
-        if (g_fft_in_l) fftw_free(g_fft_in_l);
-        if (g_fft_out_l) fftw_free(g_fft_out_l);
-        if (g_fft_in_r) fftw_free(g_fft_in_r);
-        if (g_fft_out_r) fftw_free(g_fft_out_r);
+        m_high.release();
+        m_low.release();
     }
 
     // Non-copyable
     EQProcessor(const EQProcessor&) = delete;
     EQProcessor& operator=(const EQProcessor&) = delete;
 
-    void initialize() {
-        g_fft_in_l = (double*) fftw_malloc(sizeof(double) * kFftSize);
-        g_fft_out_l = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (kFftSize / 2 + 1));
-        g_fft_plan_l = fftw_plan_dft_r2c_1d(kFftSize, g_fft_in_l, g_fft_out_l, FFTW_ESTIMATE);
+    // overlapPercent is how much consecutive analysis windows overlap: 0 analyses
+    // back-to-back windows, 50 and 75 advance by a half and a quarter window.
+    // bandEdges holds the frequency edges of the display bands (see BandLayout).
+    void initialize(int overlapPercent, const std::vector<double>& bandEdges, unsigned int maxPacketFrames) {
+        // On re-initialisation the hop and bands may change and the pending samples are dropped.
+        const size_t hop = std::max(1, kFftSize - kFftSize * overlapPercent / 100);
+        m_decimPhase = 0;
 
-        g_fft_in_r = (double*) fftw_malloc(sizeof(double) * kFftSize);
-        g_fft_out_r = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (kFftSize / 2 + 1));
-        g_fft_plan_r = fftw_plan_dft_r2c_1d(kFftSize, g_fft_in_r, g_fft_out_r, FFTW_ESTIMATE);
+        if (!m_high.plan) {
+            m_window.resize(kFftSize);
+            for (int i = 0; i < kFftSize; ++i) {
+                m_window[i] = 0.5 * (1 - cos(2 * M_PI * i / (kFftSize - 1)));
+            }
+
+            // Windowed-sinc low-pass (Blackman, 2 kHz), flat below the crossover and
+            // well down by the first frequency that folds back under it.
+            m_decimTaps.resize(kDecimTaps);
+            const double cutoff = 2000.0 / kAudioSampleRate;
+            double sum = 0.0;
+            for (int i = 0; i < kDecimTaps; ++i) {
+                const double t = i - (kDecimTaps - 1) / 2.0;
+                const double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2 * M_PI * cutoff * t) / (M_PI * t);
+                const double phase = 2 * M_PI * i / (kDecimTaps - 1);
+                m_decimTaps[i] = sinc * (0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase));
+                sum += m_decimTaps[i];
+            }
+            for (float& tap : m_decimTaps) {
+                tap /= sum;
+            }
+
+            loadFftwWisdom();
+            m_high.create(kAudioSampleRate, 1.0f);
+            // The decimated bins are kDecimation times narrower. Scaling their power by
+            // the same factor keeps a band's level (mean power per 48 kHz bin) the same on
+            // both sides of the crossover, for tones and for noise.
+            m_low.create(kAudioSampleRate / kDecimation, (float)kDecimation);
+            saveFftwWisdom();
+        }
 
-        // Precompute A-weighting curve for each FFT bin to avoid recomputation per frame.
-        a_weighting_lookup.resize(kFftSize / 2 + 1);
-        for (size_t i = 0; i < a_weighting_lookup.size(); ++i) {
-            double frequency = (static_cast<double>(kAudioSampleRate) * i) / kFftSize;
-            a_weighting_lookup[i] = computeAWeightingLinear(frequency);
+        // The decimator works on its history followed by the current packet.
+        m_decim_l.assign(kDecimTaps - 1 + maxPacketFrames, 0.0f);
+        m_decim_r.assign(kDecimTaps - 1 + maxPacketFrames, 0.0f);
+        m_decimOut_l.resize(maxPacketFrames / kDecimation + 1);
+        m_decimOut_r.resize(maxPacketFrames / kDecimation + 1);
+
+        // Room for a partial window plus the largest packet.
+        m_high.reset(hop, kFftSize + maxPacketFrames);
+        m_low.reset(hop, kFftSize + m_decimOut_l.size());
+
+        // Bands that end at or below the crossover are read from the decimated spectrum.
+        size_t split = 0;
+        while (split + 1 < bandEdges.size() && bandEdges[split + 1] <= kCrossoverHz) {
+            ++split;
         }
+        m_low.layout.build(std::vector<double>(bandEdges.begin(), bandEdges.begin() + split + 1),
+                           kFftSize / 2 + 1, m_low.binWidth(), m_low.aWeighting.data());
+        m_high.layout.build(std::vector<double>(bandEdges.begin() + split, bandEdges.end()),
+                            kFftSize / 2 + 1, m_high.binWidth(), m_high.aWeighting.data());
+        m_lowBandCount = m_low.layout.bandCount();
+        m_bands.assign(m_lowBandCount + m_high.layout.bandCount(), kFloorDb);
     }
 
-    void processAudio(const double* left_samples, const double* right_samples, unsigned int sample_count, const std::function<void(const std::string&)>& sendMessageCallback) {
-        if (!g_fft_plan_l || !g_fft_plan_r) return; // Not initialized
+    // Returns true when a new set of band levels is available from bands().
+    bool processAudio(const float* left_samples, const float* right_samples, unsigned int sample_count) {
+        if (!m_high.plan) return false; // Not initialized
 
-        fft_buffer_l.insert(fft_buffer_l.end(), left_samples, left_samples + sample_count);
-        fft_buffer_r.insert(fft_buffer_r.end(), right_samples, right_samples + sample_count);
+        m_high.buffer_l.write(left_samples, sample_count);
+        m_high.buffer_r.write(right_samples, sample_count);
 
-        if (fft_buffer_l.size() >= kFftSize) {
-            // Copy data to FFTW input buffers and apply Hann window
-            for (size_t i = 0; i < kFftSize; i++) {
-                double window = 0.5 * (1 - cos(2 * M_PI * i / (kFftSize - 1)));
-                g_fft_in_l[i] = fft_buffer_l[i] * window;
-                g_fft_in_r[i] = fft_buffer_r[i] * window;
-            }
+        bool updated = false;
+        if (m_lowBandCount > 0) {
+            decimate(left_samples, right_samples, sample_count);
+        }
+        if (m_lowBandCount > 0 && analyse(m_low)) {
+            m_low.layout.apply(m_low.power.data(), m_bands.data(), kFloorDb);
+            updated = true;
+        }
+        if (analyse(m_high)) {
+            m_high.layout.apply(m_high.power.data(), m_bands.data() + m_lowBandCount, kFloorDb);
+            updated = true;
+        }
+        return updated;
+    }
 
-            // Execute FFT
-            fftw_execute(g_fft_plan_l);
-            fftw_execute(g_fft_plan_r);
+    // Band levels in dB from the most recent analysis.
+    const std::vector<float>& bands() const {
+        return m_bands;
+    }
 
-            // Calculate averaged and normalized magnitude spectrum
-            std::vector<double> magnitudes(kFftSize / 2 + 1);
-            const double kEqGain = 15.0; // Visual gain factor
+private:
+    // Constants
+    static const int kFftSize = 2048;
+    static const int kDecimation = 8;
+    static const int kDecimTaps = 48;
+    static constexpr double kCrossoverHz = 500.0;
+    static constexpr float kFloorDb = -60.0f;
+    static const int kAudioSampleRate = 48000;
 
-            for (size_t i = 0; i < magnitudes.size(); ++i) {
-                double mag_l = sqrt(g_fft_out_l[i][0] * g_fft_out_l[i][0] + g_fft_out_l[i][1] * g_fft_out_l[i][1]);
-                double mag_r = sqrt(g_fft_out_r[i][0] * g_fft_out_r[i][0] + g_fft_out_r[i][1] * g_fft_out_r[i][1]);
-                double normalized_mag = ((mag_l + mag_r) / 2.0) / (kFftSize / 2.0);
-                magnitudes[i] = normalized_mag * kEqGain;
-            }
+    // One analysis rate: its sample rings, FFT and band weights.
+    struct Resolution {
+        Resolution() : plan(nullptr), in(nullptr), out(nullptr), sampleRate(0), powerScale(1.0f), hop(kFftSize) {}
 
-            // Apply perceptual weighting curve so the display matches common monitor behaviour.
-            if (a_weighting_lookup.size() == magnitudes.size()) {
-                for (size_t i = 0; i < magnitudes.size(); ++i) {
-                    magnitudes[i] *= a_weighting_lookup[i];
-                }
-            }
+        void create(int rate, float scale) {
+            sampleRate = rate;
+            powerScale = scale;
+            power.resize(kFftSize / 2 + 1);
+
+            // Left and right go through one complex transform as the real and imaginary
+            // parts and are separated again from its conjugate symmetry.
+            in = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * kFftSize);
+            out = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * kFftSize);
+            plan = fftwf_plan_dft_1d(kFftSize, in, out, FFTW_FORWARD, FFTW_MEASURE);
 
-            // Group magnitudes into logarithmic bands
-            std::vector<double> bands(kNumBands);
-            const double min_freq = 20.0;
-            const double max_freq = 20000.0;
-            double log_min = log(min_freq);
-            double log_max = log(max_freq);
-            double log_range = log_max - log_min;
-
-            for (int i = 0; i < kNumBands; ++i) {
-                double band_log_start = log_min + (log_range / kNumBands) * i;
-                double band_log_end = log_min + (log_range / kNumBands) * (i + 1);
-                double band_freq_start = exp(band_log_start);
-                double band_freq_end = exp(band_log_end);
-
-                int bin_start = static_cast<int>(band_freq_start * kFftSize / kAudioSampleRate);
-                int bin_end = static_cast<int>(band_freq_end * kFftSize / kAudioSampleRate);
-                if (bin_end >= magnitudes.size()) bin_end = magnitudes.size() - 1;
-                if (bin_start > bin_end) bin_start = bin_end;
-
-                double sum_sq = 0.0;
-                int bin_count = 0;
-                for (int j = bin_start; j <= bin_end; ++j) {
-                    double value = magnitudes[j];
-                    sum_sq += value * value;
-                    ++bin_count;
-                }
-
-                double rms = 0.0;
-                if (bin_count > 0) {
-                    rms = sqrt(sum_sq / bin_count);
-                }
-
-                bands[i] = (rms > 0.000001) ? (20.0 * log10(rms)) : -60.0;
+            // A-weighting curve for each FFT bin, folded into the band weights.
+            aWeighting.resize(kFftSize / 2 + 1);
+            for (size_t i = 0; i < aWeighting.size(); ++i) {
+                aWeighting[i] = computeAWeightingLinear(binWidth() * i);
             }
+        }
+
+        void reset(size_t hopSize, size_t capacity) {
+            hop = hopSize;
+            buffer_l.initialize(capacity);
+            buffer_r.initialize(capacity);
+        }
+
+        void release() {
+            if (plan) fftwf_destroy_plan(plan);
+            if (in) fftwf_free(in);
+            if (out) fftwf_free(out);
+        }
+
+        double binWidth() const {
+            return static_cast<double>(sampleRate) / kFftSize;
+        }
+
+        fftwf_plan plan;
+        fftwf_complex* in;
+        fftwf_complex* out;
+        int sampleRate;
+        float powerScale;
+        size_t hop;
+        RingBuffer<float> buffer_l;
+        RingBuffer<float> buffer_r;
+        std::vector<float> power;
+        std::vector<float> aWeighting;
+        BandLayout layout;
+    };
 
-            // Create JSON message
-            std::ostringstream oss_eq;
-            oss_eq << "{\"type\": \"eq\", \"data\": [";
-            for (int i = 0; i < kNumBands; ++i) {
-                oss_eq << bands[i] << (i == kNumBands - 1 ? "" : ",");
+    // Low-passes the packet and appends every kDecimation-th output to the low rings.
+    void decimate(const float* left, const float* right, unsigned int count) {
+        std::copy(left, left + count, m_decim_l.begin() + kDecimTaps - 1);
+        std::copy(right, right + count, m_decim_r.begin() + kDecimTaps - 1);
+
+        // m_decimPhase is where the next output's taps start, relative to the history.
+        size_t outputs = 0;
+        size_t pos = m_decimPhase;
+        for (; pos + kDecimTaps <= kDecimTaps - 1 + count; pos += kDecimation) {
+            const float* in_l = m_decim_l.data() + pos;
+            const float* in_r = m_decim_r.data() + pos;
+            float acc_l = 0.0f;
+            float acc_r = 0.0f;
+            for (int k = 0; k < kDecimTaps; ++k) {
+                acc_l += m_decimTaps[k] * in_l[k];
+                acc_r += m_decimTaps[k] * in_r[k];
             }
-            oss_eq << "]}";
-            sendMessageCallback(oss_eq.str());
+            m_decimOut_l[outputs] = acc_l;
+            m_decimOut_r[outputs] = acc_r;
+            ++outputs;
+        }
+        m_decimPhase = pos - count;
+        m_low.buffer_l.write(m_decimOut_l.data(), outputs);
+        m_low.buffer_r.write(m_decimOut_r.data(), outputs);
+
+        // Keep the last kDecimTaps - 1 inputs as the next packet's history.
+        std::copy(m_decim_l.begin() + count, m_decim_l.begin() + count + kDecimTaps - 1, m_decim_l.begin());
+        std::copy(m_decim_r.begin() + count, m_decim_r.begin() + count + kDecimTaps - 1, m_decim_r.begin());
+    }
+
+    // Computes the power spectrum of the newest full window; false while there isn't one.
+    bool analyse(Resolution& res) {
+        if (res.buffer_l.size() < (size_t)kFftSize) return false;
+
+        // Only the newest window on the hop grid is analysed; older ones would be
+        // replaced before they are published.
+        const size_t stale = (res.buffer_l.size() - kFftSize) / res.hop * res.hop;
+        res.buffer_l.consume(stale);
+        res.buffer_r.consume(stale);
 
-            // Remove processed samples
-            fft_buffer_l.erase(fft_buffer_l.begin(), fft_buffer_l.begin() + kFftSize);
-            fft_buffer_r.erase(fft_buffer_r.begin(), fft_buffer_r.begin() + kFftSize);
+        // Copy the window straight out of the rings into the FFTW input buffer and
+        // apply the Hann window. Both rings are written together, so they wrap at the
+        // same index.
+        const RingBuffer<float>::View window_l = res.buffer_l.view(0, kFftSize);
+        const RingBuffer<float>::View window_r = res.buffer_r.view(0, kFftSize);
+        applyWindow(res, window_l.first.data, window_r.first.data, 0, window_l.first.size);
+        applyWindow(res, window_l.second.data, window_r.second.data, window_l.first.size, window_l.second.size);
+
+        // Execute FFT
+        fftwf_execute(res.plan);
+
+        // Calculate the power of the averaged and normalized magnitude spectrum. With
+        // Z = FFT(l + i*r), L[k] = (Z[k] + conj(Z[N-k])) / 2 and R[k] = (Z[k] - conj(Z[N-k])) / 2i.
+        const float kEqGain = 15.0f; // Visual gain factor
+        const float scale = kEqGain / 2.0f / 2.0f / (kFftSize / 2.0f);
+
+        for (size_t i = 0; i < res.power.size(); ++i) {
+            const fftwf_complex& z = res.out[i];
+            const fftwf_complex& mirror = res.out[(kFftSize - i) & (kFftSize - 1)];
+            const float left_re = z[0] + mirror[0];
+            const float left_im = z[1] - mirror[1];
+            const float right_re = z[1] + mirror[1];
+            const float right_im = z[0] - mirror[0];
+            const float mag_l = std::sqrt(left_re * left_re + left_im * left_im);
+            const float mag_r = std::sqrt(right_re * right_re + right_im * right_im);
+            const float magnitude = (mag_l + mag_r) * scale;
+            res.power[i] = magnitude * magnitude * res.powerScale;
         }
+
+        // Advance to the next window
+        res.buffer_l.consume(res.hop);
+        res.buffer_r.consume(res.hop);
+        return true;
     }
 
-private:
-    // Constants
-    static const int kFftSize = 2048;
-    static const int kNumBands = 64;
-    static const int kAudioSampleRate = 48000;
+    // Windowed copy of count samples at window position offset into the FFT input,
+    // left as the real part and right as the imaginary part.
+    void applyWindow(Resolution& res, const float* left, const float* right, size_t offset, size_t count) {
+        const float* window = m_window.data() + offset;
+        fftwf_complex* out = res.in + offset;
+        for (size_t i = 0; i < count; ++i) {
+            out[i][0] = left[i] * window[i];
+            out[i][1] = right[i] * window[i];
+        }
+    }
 
     static double computeAWeightingLinear(double frequency) {
         if (frequency <= 0.0) {
@@ -157,13 +284,18 @@ private:
         return std::pow(10.0, a_weight_db / 20.0);
     }
 
-    // FFTW resources
-    fftw_plan g_fft_plan_l, g_fft_plan_r;
-    double *g_fft_in_l, *g_fft_in_r;
-    fftw_complex *g_fft_out_l, *g_fft_out_r;
+    Resolution m_high;
+    Resolution m_low;
+    std::vector<float> m_window;
+
+    // Decimator for the low resolution
+    std::vector<float> m_decimTaps;
+    std::vector<float> m_decim_l;
+    std::vector<float> m_decim_r;
+    std::vector<float> m_decimOut_l;
+    std::vector<float> m_decimOut_r;
+    size_t m_decimPhase;
 
-    // Buffers
-    std::vector<double> fft_buffer_l;
-    std::vector<double> fft_buffer_r;
-    std::vector<double> a_weighting_lookup;
+    size_t m_lowBandCount;
+    std::vector<float> m_bands;
 };
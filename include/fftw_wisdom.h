@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+#include <fftw3.h>
+
+// FFTW_MEASURE plans are slow to make the first time, so every single-precision plan
+// is made between these calls and the accumulated wisdom is kept on disk for the
+// next start. Plans must be made from one thread; the FFTW planner is not thread safe.
+static const char* const kFftwWisdomFile = ".fftwf_wisdom";
+
+inline void loadFftwWisdom() {
+    fftwf_import_wisdom_from_filename(kFftwWisdomFile);
+}
+
+inline void saveFftwWisdom() {
+    if (!fftwf_export_wisdom_to_filename(kFftwWisdomFile)) {
+        fprintf(stderr, "Warning: Could not save FFTW wisdom to %s\n", kFftwWisdomFile);
+    }
+}
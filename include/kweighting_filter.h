@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+
+// Streaming ITU-R BS.1770-4 K-weighting filter: the high-shelf pre-filter followed
+// by the RLB high-pass, as in k_filter() of LKFS.h. The biquad state is kept between
+// calls, so every incoming sample is filtered exactly once and consecutive
+// measurement windows don't restart from a zero state.
+class KWeightingFilter {
+public:
+    KWeightingFilter() {
+        initialize(48000.0);
+    }
+
+    void initialize(double fs) {
+        // Stage 1: pre-filter (high shelf). Same design values as k_filter().
+        double f0 = 1681.9744509555319;
+        double G  = 3.99984385397;
+        double Q  = 0.7071752369554193;
+        double K  = std::tan(M_PI * f0 / fs);
+        double Vh = std::pow(10.0, G / 20.0);
+        double Vb = std::pow(Vh, 0.499666774155);
+        double a0 = 1.0 + K / Q + K * K;
+        m_shelfB0 = (Vh + Vb * K / Q + K * K) / a0;
+        m_shelfB1 = 2.0 * (K * K - Vh) / a0;
+        m_shelfB2 = (Vh - Vb * K / Q + K * K) / a0;
+        m_shelfA1 = 2.0 * (K * K - 1.0) / a0;
+        m_shelfA2 = (1.0 - K / Q + K * K) / a0;
+
+        // Stage 2: RLB high-pass, b = {1, -2, 1}.
+        f0 = 38.13547087613982;
+        Q  = 0.5003270373253953;
+        K  = std::tan(M_PI * f0 / fs);
+        a0 = 1.0 + K / Q + K * K;
+        m_highPassA1 = 2.0 * (K * K - 1.0) / a0;
+        m_highPassA2 = (1.0 - K / Q + K * K) / a0;
+
+        reset();
+    }
+
+    void reset() {
+        m_shelfZ1 = m_shelfZ2 = 0.0;
+        m_highPassZ1 = m_highPassZ2 = 0.0;
+    }
+
+    // Transposed direct form II for both stages.
+    inline double process(double x) {
+        double v = m_shelfB0 * x + m_shelfZ1;
+        m_shelfZ1 = m_shelfB1 * x - m_shelfA1 * v + m_shelfZ2;
+        m_shelfZ2 = m_shelfB2 * x - m_shelfA2 * v;
+
+        double y = v + m_highPassZ1;
+        m_highPassZ1 = -2.0 * v - m_highPassA1 * y + m_highPassZ2;
+        m_highPassZ2 = v - m_highPassA2 * y;
+        return y;
+    }
+
+    // Filters count samples and returns the sum of the squared outputs.
+    double processEnergy(const float* x, unsigned int count) {
+        double energy = 0.0;
+        for (unsigned int i = 0; i < count; ++i) {
+            const double y = process(x[i]);
+            energy += y * y;
+        }
+        return energy;
+    }
+
+private:
+    double m_shelfB0, m_shelfB1, m_shelfB2, m_shelfA1, m_shelfA2;
+    double m_highPassA1, m_highPassA2;
+
+    double m_shelfZ1, m_shelfZ2;
+    double m_highPassZ1, m_highPassZ2;
+};
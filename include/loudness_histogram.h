@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Fixed-resolution loudness histogram for long-running integrated loudness and LRA.
+//
+// Blocks above the -70 LKFS absolute gate are binned at 0.01 LU, and every bin keeps
+// the exact sum of its block energies. Gating therefore never revisits individual
+// blocks: the cost of a query depends on the number of bins, not on how long
+// integration has been running.
+//
+// Results are not bit-identical to the per-block computation in LKFS.h:
+//  - integrated(): only the bin straddling the relative threshold is approximated,
+//    pro rata. The error is bounded by that bin's share of the gated blocks: on
+//    programme material it stays under 0.01 LU after a minute of integration and
+//    falls as integration goes on.
+//  - loudnessRange(): each percentile is resolved to the centre of its 0.01 LU bin,
+//    and the values in the bin straddling the -20 LU gate are kept or dropped
+//    together. The range stays within a few hundredths of an LU (under 0.03 LU in
+//    randomised comparisons with LRA_with_shorts()).
+//
+// The bins take about 96 KB, so they are only allocated by allocate() and released
+// by release(); meters that aren't integrating carry none.
+class LoudnessHistogram {
+public:
+    LoudnessHistogram() {
+        reset();
+    }
+
+    // Allocates the bins if needed and clears them.
+    void allocate() {
+        m_counts.assign(kBinCount, 0);
+        m_energies.assign(kBinCount, 0.0);
+        reset();
+    }
+
+    // Frees the bins. add() ignores values until the next allocate().
+    void release() {
+        std::vector<unsigned int>().swap(m_counts);
+        std::vector<double>().swap(m_energies);
+        reset();
+    }
+
+    bool isAllocated() const {
+        return !m_counts.empty();
+    }
+
+    void reset() {
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+        std::fill(m_energies.begin(), m_energies.end(), 0.0);
+        m_addedCount = 0;
+        m_totalCount = 0;
+        m_totalEnergy = 0.0;
+    }
+
+    // Adds one block loudness value (LKFS). Blocks at or below the absolute gate are dropped.
+    void add(double loudness) {
+        if (!isAllocated()) {
+            return;
+        }
+        m_addedCount += 1;
+        if (!(loudness > kAbsoluteGate)) {
+            return;
+        }
+        const double energy = std::pow(10.0, (loudness + 0.691) / 10.0);
+        const int bin = binIndex(loudness);
+        m_counts[bin] += 1;
+        m_energies[bin] += energy;
+        m_totalCount += 1;
+        m_totalEnergy += energy;
+    }
+
+    // Number of values added since the last reset, including gated-out ones.
+    unsigned long size() const {
+        return m_addedCount;
+    }
+
+    // I-LKFS with the -70 LKFS absolute gate and the -10 LU relative gate.
+    // Mirrors integrated_loudness_with_momentaries() in LKFS.h.
+    double integrated() const {
+        return gatedLoudness(10.0);
+    }
+
+    // Loudness range (LU) of short-term values: -20 LU relative gate, then L95 - L10
+    // with linear interpolation. Mirrors LRA_with_shorts() in LKFS.h, with every
+    // value resolved to the centre of its bin, so percentiles need no sorting.
+    double loudnessRange() const {
+        if (m_totalCount == 0) {
+            return 0.0; // No values above absolute gate
+        }
+
+        // A bin is kept when its centre lies above the relative threshold.
+        const double Gamma_r = relativeThreshold(20.0);
+        const double position = std::floor((Gamma_r - kAbsoluteGate) * kBinsPerLU - 0.5) + 1.0;
+        const int firstBin = static_cast<int>(std::min(std::max(position, 0.0), static_cast<double>(kBinCount)));
+
+        unsigned long n = 0;
+        for (int bin = firstBin; bin < kBinCount; ++bin) {
+            n += m_counts[bin];
+        }
+        if (n < 2) {
+            return 0.0; // Not enough data to compute a meaningful range
+        }
+
+        return percentile(firstBin, n, 0.95) - percentile(firstBin, n, 0.10);
+    }
+
+private:
+    static constexpr double kAbsoluteGate = -70.0;
+    static constexpr double kBinsPerLU = 100.0;
+    // -70 .. +10 LKFS; anything louder lands in the top bin with its exact energy.
+    static const int kBinCount = 8000;
+
+    static int binIndex(double loudness) {
+        int bin = static_cast<int>((loudness - kAbsoluteGate) * kBinsPerLU);
+        if (bin < 0) bin = 0;
+        if (bin >= kBinCount) bin = kBinCount - 1;
+        return bin;
+    }
+
+    // Relative threshold (absolute-gated mean minus relativeGateLU), in LKFS.
+    double relativeThreshold(double relativeGateLU) const {
+        const double z_avg = m_totalEnergy / static_cast<double>(m_totalCount);
+        return -0.691 + 10.0 * std::log10(z_avg) - relativeGateLU;
+    }
+
+    double gatedLoudness(double relativeGateLU) const {
+        const double Gamma_r = relativeThreshold(relativeGateLU);
+        // If the relative threshold is under the absolute one, return the abs gated result.
+        // The negated comparison also passes NaN through for an empty histogram.
+        if (!(Gamma_r >= kAbsoluteGate)) return Gamma_r + relativeGateLU;
+
+        // Bins entirely above the threshold count in full. The bin straddling it is
+        // taken pro rata, assuming its blocks are spread evenly across 0.01 LU.
+        const double position = (Gamma_r - kAbsoluteGate) * kBinsPerLU;
+        const int straddling = static_cast<int>(position);
+        double count = 0.0;
+        double energy = 0.0;
+        if (straddling < kBinCount) {
+            const double fraction = 1.0 - (position - straddling);
+            count = fraction * m_counts[straddling];
+            energy = fraction * m_energies[straddling];
+        }
+        for (int bin = straddling + 1; bin < kBinCount; ++bin) {
+            count += m_counts[bin];
+            energy += m_energies[bin];
+        }
+        return -0.691 + 10.0 * std::log10(energy / count);
+    }
+
+    static double binCentre(int bin) {
+        return kAbsoluteGate + (bin + 0.5) / kBinsPerLU;
+    }
+
+    // Loudness of the value at the given 0-based rank among the bins from firstBin up.
+    double valueAtRank(int firstBin, unsigned long rank) const {
+        unsigned long seen = 0;
+        for (int bin = firstBin; bin < kBinCount; ++bin) {
+            seen += m_counts[bin];
+            if (seen > rank) return binCentre(bin);
+        }
+        return binCentre(kBinCount - 1);
+    }
+
+    double percentile(int firstBin, unsigned long n, double p) const {
+        const double index = (n - 1) * p;
+        const unsigned long lower = static_cast<unsigned long>(index);
+        const double frac = index - lower;
+        const double lowerValue = valueAtRank(firstBin, lower);
+        if (lower + 1 >= n) {
+            return lowerValue;
+        }
+        return lowerValue * (1.0 - frac) + valueAtRank(firstBin, lower + 1) * frac;
+    }
+
+    std::vector<unsigned int> m_counts;
+    std::vector<double> m_energies;
+    unsigned long m_addedCount;
+    unsigned long m_totalCount;
+    double m_totalEnergy;
+};
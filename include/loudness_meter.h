@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "kweighting_filter.h"
+#include "loudness_histogram.h"
+
+// Values produced by a LoudnessMeter for one completed 100 ms block.
+struct LoudnessReading {
+    double momentary;
+    double shortTerm;
+    double integrated;
+    double loudnessRange;
+    bool hasShortTerm;
+    bool hasIntegrated;
+    bool hasLoudnessRange;
+};
+
+// Streaming BS.1770 loudness meter for one channel group (a stereo pair, 5.1 or 7.1).
+//
+// Each member channel goes through its own persistent K-weighting filter once, and
+// the weighted power is accumulated into 100 ms blocks.
+// The energies of the last 30 blocks are kept in a ring: momentary loudness (400 ms)
+// sums the newest 4 and short-term loudness (3 s) all 30, so neither meter ever
+// re-filters PCM. While integrating, momentary and short-term values also feed the
+// meter's own histograms for integrated loudness and LRA, so every meter is a
+// complete, independent M/S/I/LRA instrument. The histograms exist only while
+// integrating.
+class LoudnessMeter {
+public:
+    static const int kMaxChannels = 8;
+
+    LoudnessMeter() : m_channelCount(0), m_isIntegrating(false) {
+        initialize(48000, nullptr, nullptr, 0);
+    }
+
+    // channels: plane indices of the member channels.
+    // weights: BS.1770 channel weights G_i (1.0 front, 1.41 surround). Channels
+    // with a zero weight (LFE) are left out of the group entirely.
+    void initialize(int sampleRate, const unsigned int* channels, const double* weights, int channelCount) {
+        m_blockSize = sampleRate / 10;
+        m_channelCount = 0;
+        for (int i = 0; i < channelCount && m_channelCount < kMaxChannels; ++i) {
+            if (weights[i] <= 0.0) continue;
+            m_channels[m_channelCount] = channels[i];
+            m_weights[m_channelCount] = weights[i];
+            m_filters[m_channelCount].initialize(sampleRate);
+            ++m_channelCount;
+        }
+        reset();
+    }
+
+    void reset() {
+        for (int c = 0; c < m_channelCount; ++c) {
+            m_filters[c].reset();
+        }
+        m_blockEnergy = 0.0;
+        m_blockFill = 0;
+        m_blockIndex = 0;
+        m_blockCount = 0;
+        for (int i = 0; i < kShortTermBlocks; ++i) {
+            m_blocks[i] = 0.0;
+        }
+        m_readings.clear();
+        // Copies of a meter don't inherit the capacity, so reserve here.
+        m_readings.reserve(kMaxReadingsPerPacket);
+    }
+
+    // Allocates the integration histograms; they are freed again on stop, so idle
+    // meters stay small. The allocation happens once per start, not per packet.
+    void startIntegration() {
+        m_momentaryHistogram.allocate();
+        m_shortTermHistogram.allocate();
+        m_isIntegrating = true;
+    }
+
+    void stopIntegration() {
+        m_momentaryHistogram.release();
+        m_shortTermHistogram.release();
+        m_isIntegrating = false;
+    }
+
+    unsigned int channel(int member) const {
+        return m_channels[member];
+    }
+
+    int channelCount() const {
+        return m_channelCount;
+    }
+
+    // Runs a packet through the meter; planes[ch] holds frameCount samples of channel
+    // ch. Each channel is filtered in runs up to the next block boundary. readings()
+    // then holds one entry for every 100 ms block completed by this packet.
+    void processPlanes(const float* const* planes, unsigned int frameCount) {
+        m_readings.clear();
+        unsigned int offset = 0;
+        while (offset < frameCount) {
+            const unsigned int run = std::min(frameCount - offset, (unsigned int)(m_blockSize - m_blockFill));
+            for (int c = 0; c < m_channelCount; ++c) {
+                m_blockEnergy += m_weights[c] * m_filters[c].processEnergy(planes[m_channels[c]] + offset, run);
+            }
+            offset += run;
+            m_blockFill += run;
+            if (m_blockFill == m_blockSize) {
+                completeBlock();
+                if (hasMomentary()) {
+                    m_readings.push_back(currentReading());
+                }
+            }
+        }
+    }
+
+    const std::vector<LoudnessReading>& readings() const {
+        return m_readings;
+    }
+
+    bool hasMomentary() const {
+        return m_blockCount >= kMomentaryBlocks;
+    }
+
+    bool hasShortTerm() const {
+        return m_blockCount >= kShortTermBlocks;
+    }
+
+    // M-LKFS over the last 400 ms: -0.691 + 10 log10(sum G_i z_i)
+    double momentary() const {
+        return loudnessOfLastBlocks(kMomentaryBlocks);
+    }
+
+    // S-LKFS over the last 3 s
+    double shortTerm() const {
+        return loudnessOfLastBlocks(kShortTermBlocks);
+    }
+
+private:
+    static const int kMomentaryBlocks = 4;
+    static const int kShortTermBlocks = 30;
+    static const int kMaxReadingsPerPacket = 4;
+
+    void completeBlock() {
+        m_blocks[m_blockIndex] = m_blockEnergy;
+        m_blockIndex = (m_blockIndex + 1) % kShortTermBlocks;
+        if (m_blockCount < kShortTermBlocks) ++m_blockCount;
+        m_blockEnergy = 0.0;
+        m_blockFill = 0;
+    }
+
+    LoudnessReading currentReading() {
+        LoudnessReading reading = {};
+        reading.momentary = momentary();
+        reading.hasShortTerm = hasShortTerm();
+        if (reading.hasShortTerm) {
+            reading.shortTerm = shortTerm();
+        }
+        if (!m_isIntegrating) {
+            return reading;
+        }
+
+        m_momentaryHistogram.add(reading.momentary);
+        reading.integrated = m_momentaryHistogram.integrated();
+        reading.hasIntegrated = true;
+
+        if (reading.hasShortTerm) {
+            m_shortTermHistogram.add(reading.shortTerm);
+            if (m_shortTermHistogram.size() > 1) { // Need at least 2 values for a range
+                reading.loudnessRange = m_shortTermHistogram.loudnessRange();
+                reading.hasLoudnessRange = true;
+            }
+        }
+        return reading;
+    }
+
+    double loudnessOfLastBlocks(int count) const {
+        double sum = 0.0;
+        int index = m_blockIndex;
+        for (int i = 0; i < count; ++i) {
+            index = (index == 0) ? kShortTermBlocks - 1 : index - 1;
+            sum += m_blocks[index];
+        }
+        const double z = sum / (static_cast<double>(m_blockSize) * count);
+        return -0.691 + 10.0 * std::log10(z);
+    }
+
+    KWeightingFilter m_filters[kMaxChannels];
+    unsigned int m_channels[kMaxChannels];
+    double m_weights[kMaxChannels];
+    int m_channelCount;
+
+    int m_blockSize;
+    int m_blockFill;
+    double m_blockEnergy;
+
+    double m_blocks[kShortTermBlocks];
+    int m_blockIndex;
+    int m_blockCount;
+
+    bool m_isIntegrating;
+    LoudnessHistogram m_momentaryHistogram;
+    LoudnessHistogram m_shortTermHistogram;
+
+    std::vector<LoudnessReading> m_readings;
+};
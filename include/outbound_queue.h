@@ -0,0 +1,149 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Outbound WebSocket messages, queued by the producers and sent by one writer thread.
+//
+// Two policies:
+//  - topics hold one message each and the newest value wins. Meter telemetry goes
+//    here: when the connection is slow, stale frames are replaced, not queued.
+//  - events go through a bounded FIFO. When it is full, the oldest event is
+//    dropped and counted.
+// Producers only copy the payload under a short lock and never touch the socket,
+// so a stalled relay can no longer stall capture.
+class OutboundQueue {
+public:
+    struct Message {
+        std::string payload;
+        bool binary;
+        bool topic = false; // set by take() for latest-wins topic values
+    };
+
+    struct Stats {
+        size_t depth;             // messages waiting for the writer
+        unsigned long sent;       // messages handed to the writer
+        unsigned long superseded; // topic values replaced before they were sent
+        unsigned long dropped;    // events dropped from a full FIFO
+        unsigned long skipped;    // topic values the writer skipped under backpressure
+    };
+
+    OutboundQueue() : m_eventCapacity(0), m_nextTopic(0), m_stopping(false) {
+        m_stats = Stats();
+    }
+
+    void initialize(size_t topicCount, size_t eventCapacity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_topics.assign(topicCount, Topic());
+        m_events.clear();
+        m_eventCapacity = eventCapacity;
+        m_nextTopic = 0;
+        m_stopping = false;
+        m_stats = Stats();
+    }
+
+    // Replaces the pending value of a topic.
+    void publish(size_t topic, const void* data, size_t size, bool binary) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Topic& slot = m_topics[topic];
+            if (slot.pending) {
+                m_stats.superseded += 1;
+            } else {
+                m_stats.depth += 1;
+            }
+            slot.message.payload.assign(static_cast<const char*>(data), size);
+            slot.message.binary = binary;
+            slot.pending = true;
+        }
+        m_wake.notify_one();
+    }
+
+    // Appends an event, dropping the oldest one when the FIFO is full.
+    void push(const void* data, size_t size, bool binary) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_events.empty() && m_events.size() >= m_eventCapacity) {
+                m_events.pop_front();
+                m_stats.dropped += 1;
+                m_stats.depth -= 1;
+            }
+            m_events.push_back(Message{ std::string(static_cast<const char*>(data), size), binary });
+            m_stats.depth += 1;
+        }
+        m_wake.notify_one();
+    }
+
+    // Writer: blocks until a message is queued and moves it into message.
+    // Events go first, then topics in turn. Returns false once stop() is called.
+    bool take(Message& message) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stopping || m_stats.depth > 0; });
+        if (m_stopping) {
+            return false;
+        }
+
+        if (!m_events.empty()) {
+            message = std::move(m_events.front());
+            m_events.pop_front();
+            message.topic = false;
+        } else {
+            Topic* slot = nullptr;
+            while (!slot) {
+                Topic& candidate = m_topics[m_nextTopic];
+                m_nextTopic = (m_nextTopic + 1) % m_topics.size();
+                if (candidate.pending) slot = &candidate;
+            }
+            // Swap so both strings keep their capacity for the next frame.
+            message.payload.swap(slot->message.payload);
+            message.binary = slot->message.binary;
+            message.topic = true;
+            slot->pending = false;
+        }
+        m_stats.depth -= 1;
+        m_stats.sent += 1;
+        return true;
+    }
+
+    // Writer: a topic value taken from the queue was not sent because the
+    // connection is still flushing earlier data.
+    void skipped() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.sent -= 1;
+        m_stats.skipped += 1;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Topic {
+        Topic() : pending(false) {
+            message.binary = false;
+        }
+        Message message;
+        bool pending;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<Topic> m_topics;
+    std::deque<Message> m_events;
+    size_t m_eventCapacity;
+    size_t m_nextTopic;
+    bool m_stopping;
+    Stats m_stats;
+};
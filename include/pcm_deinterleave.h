@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PCM_DEINTERLEAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// Splits one packet of interleaved PCM into per-channel float planes (full scale 1.0)
+// and measures the sample peak of every channel in the same pass.
+//
+// Kernels are instantiated at compile time for 16- and 32-bit samples and for 2, 8 and
+// 16 channels; other channel counts use a generic scalar loop. On x86 the SSE4.1 and
+// AVX2 kernels are compiled with target attributes and chosen at initialize() from
+// what the CPU supports, so the binary still runs on any x86-64. A vector kernel
+// converts a block of 4 or 8 frames, folds it into the peaks, transposes it and
+// stores one run per plane. Frames left over at the end of a packet use the scalar loop.
+class PcmDeinterleaver {
+public:
+    PcmDeinterleaver() : m_channelCount(0), m_kernel(nullptr), m_kernelName("none") {}
+
+    // sampleDepth: 16 or 32 bits. Returns false for any other depth.
+    bool initialize(unsigned int channelCount, unsigned int sampleDepth) {
+        m_channelCount = channelCount;
+        if (sampleDepth == 16) {
+            selectKernel<int16_t>();
+        } else if (sampleDepth == 32) {
+            selectKernel<int32_t>();
+        } else {
+            m_kernel = nullptr;
+            m_kernelName = "none";
+            return false;
+        }
+        return true;
+    }
+
+    // planes[ch] receives frameCount samples of channel ch; peaks[ch] is set to the
+    // largest magnitude of channel ch in the packet.
+    void process(const void* pcm, unsigned int frameCount, float* const* planes, float* peaks) const {
+        m_kernel(pcm, frameCount, m_channelCount, planes, peaks);
+    }
+
+    const char* kernelName() const {
+        return m_kernelName;
+    }
+
+private:
+    typedef void (*Kernel)(const void* pcm, unsigned int frameCount, unsigned int channelCount,
+                           float* const* planes, float* peaks);
+
+    template <typename Sample>
+    static constexpr float scaleOf() {
+        return (sizeof(Sample) == 2) ? 1.0f / 32768.0f : 1.0f / 2147483648.0f;
+    }
+
+    template <typename Sample>
+    void selectKernel() {
+        switch (m_channelCount) {
+            case 2: selectKernel<Sample, 2>(); break;
+            case 8: selectKernel<Sample, 8>(); break;
+            case 16: selectKernel<Sample, 16>(); break;
+            default:
+                m_kernel = &scalarKernel<Sample, 0>;
+                m_kernelName = "scalar";
+                break;
+        }
+    }
+
+    template <typename Sample, unsigned int Channels>
+    void selectKernel() {
+#if PCM_DEINTERLEAVE_X86
+        if (__builtin_cpu_supports("avx2")) {
+            m_kernel = &avx2Kernel<Sample, Channels>;
+            m_kernelName = "avx2";
+            return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            m_kernel = &sse41Kernel<Sample, Channels>;
+            m_kernelName = "sse4.1";
+            return;
+        }
+#endif
+        m_kernel = &scalarKernel<Sample, Channels>;
+        m_kernelName = "scalar";
+    }
+
+    // Frames [begin, end), folding into peaks. Channels == 0 means a runtime count.
+    template <typename Sample, unsigned int Channels>
+    static inline void convertFrames(const Sample* pcm, unsigned int begin, unsigned int end,
+                                     unsigned int channelCount, float* const* planes, float* peaks) {
+        const unsigned int channels = Channels ? Channels : channelCount;
+        const float scale = scaleOf<Sample>();
+        for (unsigned int i = begin; i < end; ++i) {
+            const Sample* frame = pcm + (size_t)i * channels;
+            for (unsigned int ch = 0; ch < channels; ++ch) {
+                const float sample = (float)frame[ch] * scale;
+                planes[ch][i] = sample;
+                peaks[ch] = std::max(peaks[ch], std::fabs(sample));
+            }
+        }
+    }
+
+    template <typename Sample, unsigned int Channels>
+    static void scalarKernel(const void* pcm, unsigned int frameCount, unsigned int channelCount,
+                             float* const* planes, float* peaks) {
+        std::fill(peaks, peaks + (Channels ? Channels : channelCount), 0.0f);
+        convertFrames<Sample, Channels>(static_cast<const Sample*>(pcm), 0, frameCount, channelCount, planes, peaks);
+    }
+
+#if PCM_DEINTERLEAVE_X86
+    __attribute__((target("sse4.1"))) static inline __m128 load4(const int16_t* pcm) {
+        return _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pcm))));
+    }
+
+    __attribute__((target("sse4.1"))) static inline __m128 load4(const int32_t* pcm) {
+        return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm)));
+    }
+
+    __attribute__((target("sse4.1"))) static inline float horizontalMax(__m128 v) {
+        v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+
+    template <typename Sample, unsigned int Channels>
+    __attribute__((target("sse4.1"))) static void sse41Kernel(const void* data, unsigned int frameCount, unsigned int,
+                                                            float* const* planes, float* peaks) {
+        const Sample* pcm = static_cast<const Sample*>(data);
+        const __m128 scale = _mm_set1_ps(scaleOf<Sample>());
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        unsigned int i = 0;
+
+        if constexpr (Channels == 2) {
+            __m128 peakL = _mm_setzero_ps();
+            __m128 peakR = _mm_setzero_ps();
+            for (; i + 4 <= frameCount; i += 4) {
+                const __m128 a = _mm_mul_ps(load4(pcm + 2 * i), scale);     // L0 R0 L1 R1
+                const __m128 b = _mm_mul_ps(load4(pcm + 2 * i + 4), scale); // L2 R2 L3 R3
+                const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                peakL = _mm_max_ps(peakL, _mm_andnot_ps(signMask, left));
+                peakR = _mm_max_ps(peakR, _mm_andnot_ps(signMask, right));
+                _mm_storeu_ps(planes[0] + i, left);
+                _mm_storeu_ps(planes[1] + i, right);
+            }
+            peaks[0] = horizontalMax(peakL);
+            peaks[1] = horizontalMax(peakR);
+        } else {
+            static_assert(Channels % 4 == 0, "SSE kernel needs 2 or a multiple of 4 channels");
+            __m128 peak[Channels / 4];
+            for (unsigned int g = 0; g < Channels / 4; ++g) {
+                peak[g] = _mm_setzero_ps();
+            }
+            for (; i + 4 <= frameCount; i += 4) {
+                const Sample* block = pcm + (size_t)i * Channels;
+                for (unsigned int g = 0; g < Channels / 4; ++g) {
+                    __m128 r0 = _mm_mul_ps(load4(block + 4 * g), scale);
+                    __m128 r1 = _mm_mul_ps(load4(block + Channels + 4 * g), scale);
+                    __m128 r2 = _mm_mul_ps(load4(block + 2 * Channels + 4 * g), scale);
+                    __m128 r3 = _mm_mul_ps(load4(block + 3 * Channels + 4 * g), scale);
+                    const __m128 m01 = _mm_max_ps(_mm_andnot_ps(signMask, r0), _mm_andnot_ps(signMask, r1));
+                    const __m128 m23 = _mm_max_ps(_mm_andnot_ps(signMask, r2), _mm_andnot_ps(signMask, r3));
+                    peak[g] = _mm_max_ps(peak[g], _mm_max_ps(m01, m23));
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    _mm_storeu_ps(planes[4 * g] + i, r0);
+                    _mm_storeu_ps(planes[4 * g + 1] + i, r1);
+                    _mm_storeu_ps(planes[4 * g + 2] + i, r2);
+                    _mm_storeu_ps(planes[4 * g + 3] + i, r3);
+                }
+            }
+            for (unsigned int g = 0; g < Channels / 4; ++g) {
+                _mm_storeu_ps(peaks + 4 * g, peak[g]);
+            }
+        }
+        convertFrames<Sample, Channels>(pcm, i, frameCount, Channels, planes, peaks);
+    }
+
+    __attribute__((target("avx2"))) static inline __m256 load8(const int16_t* pcm) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm))));
+    }
+
+    __attribute__((target("avx2"))) static inline __m256 load8(const int32_t* pcm) {
+        return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm)));
+    }
+
+    __attribute__((target("avx2"))) static inline float horizontalMax(__m256 v) {
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        return _mm_cvtss_f32(m);
+    }
+
+    // Even lanes of a and b in order: a0 a2 a4 a6 b0 b2 b4 b6 (odd with Odd = true).
+    template <bool Odd>
+    __attribute__((target("avx2"))) static inline __m256 deinterleave8(__m256 a, __m256 b) {
+        const __m256 lanes = Odd ? _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))
+                                 : _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(lanes), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    template <typename Sample, unsigned int Channels>
+    __attribute__((target("avx2"))) static void avx2Kernel(const void* data, unsigned int frameCount, unsigned int,
+                                                          float* const* planes, float* peaks) {
+        const Sample* pcm = static_cast<const Sample*>(data);
+        const __m256 scale = _mm256_set1_ps(scaleOf<Sample>());
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        unsigned int i = 0;
+
+        if constexpr (Channels == 2) {
+            __m256 peakL = _mm256_setzero_ps();
+            __m256 peakR = _mm256_setzero_ps();
+            for (; i + 8 <= frameCount; i += 8) {
+                const __m256 a = _mm256_mul_ps(load8(pcm + 2 * i), scale);
+                const __m256 b = _mm256_mul_ps(load8(pcm + 2 * i + 8), scale);
+                const __m256 left = deinterleave8<false>(a, b);
+                const __m256 right = deinterleave8<true>(a, b);
+                peakL = _mm256_max_ps(peakL, _mm256_andnot_ps(signMask, left));
+                peakR = _mm256_max_ps(peakR, _mm256_andnot_ps(signMask, right));
+                _mm256_storeu_ps(planes[0] + i, left);
+                _mm256_storeu_ps(planes[1] + i, right);
+            }
+            peaks[0] = horizontalMax(peakL);
+            peaks[1] = horizontalMax(peakR);
+        } else {
+            static_assert(Channels % 8 == 0, "AVX2 kernel needs 2 or a multiple of 8 channels");
+            __m256 peak[Channels / 8];
+            for (unsigned int g = 0; g < Channels / 8; ++g) {
+                peak[g] = _mm256_setzero_ps();
+            }
+            for (; i + 8 <= frameCount; i += 8) {
+                const Sample* block = pcm + (size_t)i * Channels;
+                for (unsigned int g = 0; g < Channels / 8; ++g) {
+                    __m256 r[8];
+                    __m256 magnitude = _mm256_setzero_ps();
+                    for (unsigned int k = 0; k < 8; ++k) {
+                        r[k] = _mm256_mul_ps(load8(block + k * Channels + 8 * g), scale);
+                        magnitude = _mm256_max_ps(magnitude, _mm256_andnot_ps(signMask, r[k]));
+                    }
+                    peak[g] = _mm256_max_ps(peak[g], magnitude);
+
+                    // 8x8 transpose: row k holds frame i + k, column c channel 8g + c.
+                    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+                    const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+                    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+                    const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+                    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+                    const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+                    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+                    const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+                    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+                    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+                    const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+                    const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+                    float* const* out = planes + 8 * g;
+                    _mm256_storeu_ps(out[0] + i, _mm256_permute2f128_ps(s0, s4, 0x20));
+                    _mm256_storeu_ps(out[1] + i, _mm256_permute2f128_ps(s1, s5, 0x20));
+                    _mm256_storeu_ps(out[2] + i, _mm256_permute2f128_ps(s2, s6, 0x20));
+                    _mm256_storeu_ps(out[3] + i, _mm256_permute2f128_ps(s3, s7, 0x20));
+                    _mm256_storeu_ps(out[4] + i, _mm256_permute2f128_ps(s0, s4, 0x31));
+                    _mm256_storeu_ps(out[5] + i, _mm256_permute2f128_ps(s1, s5, 0x31));
+                    _mm256_storeu_ps(out[6] + i, _mm256_permute2f128_ps(s2, s6, 0x31));
+                    _mm256_storeu_ps(out[7] + i, _mm256_permute2f128_ps(s3, s7, 0x31));
+                }
+            }
+            for (unsigned int g = 0; g < Channels / 8; ++g) {
+                _mm256_storeu_ps(peaks + 8 * g, peak[g]);
+            }
+        }
+        convertFrames<Sample, Channels>(pcm, i, frameCount, Channels, planes, peaks);
+    }
+#endif
+
+    unsigned int m_channelCount;
+    Kernel m_kernel;
+    const char* m_kernelName;
+};
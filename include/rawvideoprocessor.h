@@ -64,7 +64,9 @@ public:
         scaledFrame->format = AV_PIX_FMT_YUV420P;
         if (av_frame_get_buffer(scaledFrame, 0) < 0) { std::cerr << "Could not allocate buffer for scaled frame." << std::endl; return false; }
 
-        webrtc_handler->RegisterH264Track("video-raw", "stream-raw", "video-raw", 43);
+        if (!webrtc_handler->RegisterH264Track("video-raw", "stream-raw", "video-raw", 43)) {
+            std::cerr << "[Info] WebRTC track video-raw already registered, reusing it." << std::endl;
+        }
         initialized = true;
         return true;
     }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <stddef.h>
+#include <vector>
+
+// Fixed-capacity FIFO of samples for sliding analysis windows.
+//
+// The storage is a power-of-two array and the read and write positions run freely,
+// masked on access, so appending a packet is at most two copies and advancing the
+// window is a single index bump. A window is read in place as a View: at most two
+// contiguous spans, the part before the wrap and the part after it. Not thread safe;
+// writer and reader are the same thread.
+template <typename T>
+class RingBuffer {
+public:
+    struct Span {
+        const T* data;
+        size_t size;
+    };
+
+    struct View {
+        Span first;
+        Span second;
+
+        size_t size() const {
+            return first.size + second.size;
+        }
+
+        const T& operator[](size_t index) const {
+            return (index < first.size) ? first.data[index] : second.data[index - first.size];
+        }
+    };
+
+    RingBuffer() : m_mask(0), m_read(0), m_write(0) {}
+
+    // capacity is rounded up to a power of two.
+    void initialize(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        m_data.assign(size, T());
+        m_mask = size - 1;
+        clear();
+    }
+
+    void clear() {
+        m_read = 0;
+        m_write = 0;
+    }
+
+    size_t capacity() const {
+        return m_data.size();
+    }
+
+    size_t size() const {
+        return m_write - m_read;
+    }
+
+    // Appends count items. When they don't fit, the oldest items are dropped.
+    void write(const T* items, size_t count) {
+        if (count > capacity()) {
+            items += count - capacity();
+            count = capacity();
+        }
+        const size_t start = m_write & m_mask;
+        const size_t head = std::min(count, capacity() - start);
+        std::copy(items, items + head, m_data.begin() + start);
+        std::copy(items + head, items + count, m_data.begin());
+        m_write += count;
+        if (size() > capacity()) {
+            m_read = m_write - capacity();
+        }
+    }
+
+    // count items starting offset items after the oldest one. The view stays valid
+    // until the next write().
+    View view(size_t offset, size_t count) const {
+        const size_t start = (m_read + offset) & m_mask;
+        const size_t head = std::min(count, capacity() - start);
+        View view;
+        view.first.data = m_data.data() + start;
+        view.first.size = head;
+        view.second.data = m_data.data();
+        view.second.size = count - head;
+        return view;
+    }
+
+    // Drops the count oldest items.
+    void consume(size_t count) {
+        m_read += std::min(count, size());
+    }
+
+private:
+    std::vector<T> m_data;
+    size_t m_mask;
+    size_t m_read;
+    size_t m_write;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Writes telemetry frames into a ring of fixed-size slots in a /dev/shm file, so a
+// reader on the same host can pick up the latest frame without a socket hop.
+//
+// Layout, all little-endian:
+//   header (64 bytes)  u32 magic 'SLMS' | u32 version | u32 slot count | u32 slot size
+//                      u64 sequence of the newest complete slot | zero padding
+//   slot i             u64 sequence | u32 length | u32 reserved | payload
+//
+// Frame n goes to slot n % slot count. The slot's sequence is cleared while it is
+// written and set to n afterwards, then the header sequence is published. A reader
+// takes the header sequence, copies that slot, and keeps the copy only if the slot
+// sequence still matches afterwards. server.js reads the file this way.
+class ShmTelemetryWriter {
+public:
+    static const uint32_t kMagic = 0x534D4C53; // "SLMS"
+    static const uint32_t kVersion = 1;
+    static const size_t kHeaderSize = 64;
+    static const size_t kSlotHeaderSize = 16;
+
+    ShmTelemetryWriter() : m_fd(-1), m_base(NULL), m_mappedSize(0), m_slotCount(0),
+                           m_slotSize(0), m_sequence(0), m_oversized(0) {}
+
+    ~ShmTelemetryWriter() {
+        close();
+    }
+
+    // Non-copyable
+    ShmTelemetryWriter(const ShmTelemetryWriter&) = delete;
+    ShmTelemetryWriter& operator=(const ShmTelemetryWriter&) = delete;
+
+    // name: shared memory object name such as "sdi-loudness" (/dev/shm/sdi-loudness).
+    bool open(const char* name, uint32_t slotCount, uint32_t slotSize) {
+        close();
+        m_name = std::string("/") + name;
+        m_fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (m_fd < 0) {
+            perror("shm_open");
+            return false;
+        }
+
+        m_mappedSize = kHeaderSize + (size_t)slotCount * slotSize;
+        if (ftruncate(m_fd, m_mappedSize) != 0) {
+            perror("ftruncate");
+            close();
+            return false;
+        }
+
+        void* base = mmap(NULL, m_mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (base == MAP_FAILED) {
+            perror("mmap");
+            close();
+            return false;
+        }
+        m_base = static_cast<uint8_t*>(base);
+        memset(m_base, 0, m_mappedSize);
+
+        m_slotCount = slotCount;
+        m_slotSize = slotSize;
+        m_sequence = 0;
+        m_oversized = 0;
+        memcpy(m_base + 0, &kMagic, sizeof(kMagic));
+        memcpy(m_base + 4, &kVersion, sizeof(kVersion));
+        memcpy(m_base + 8, &m_slotCount, sizeof(m_slotCount));
+        memcpy(m_base + 12, &m_slotSize, sizeof(m_slotSize));
+        return true;
+    }
+
+    void close() {
+        if (m_base) {
+            munmap(m_base, m_mappedSize);
+            m_base = NULL;
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            shm_unlink(m_name.c_str());
+            m_fd = -1;
+        }
+    }
+
+    bool isOpen() const {
+        return m_base != NULL;
+    }
+
+    // Publishes one frame. Frames that don't fit a slot are counted and skipped.
+    bool write(const void* data, size_t size) {
+        if (!m_base) return false;
+        if (size > m_slotSize - kSlotHeaderSize) {
+            m_oversized += 1;
+            return false;
+        }
+
+        const uint64_t sequence = ++m_sequence;
+        uint8_t* slot = m_base + kHeaderSize + (size_t)(sequence % m_slotCount) * m_slotSize;
+        uint64_t* slotSequence = reinterpret_cast<uint64_t*>(slot);
+        uint64_t* headerSequence = reinterpret_cast<uint64_t*>(m_base + 16);
+
+        __atomic_store_n(slotSequence, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        const uint32_t length = (uint32_t)size;
+        memcpy(slot + 8, &length, sizeof(length));
+        memcpy(slot + kSlotHeaderSize, data, size);
+        __atomic_store_n(slotSequence, sequence, __ATOMIC_RELEASE);
+        __atomic_store_n(headerSequence, sequence, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    unsigned long oversized() const {
+        return m_oversized;
+    }
+
+private:
+    std::string m_name;
+    int m_fd;
+    uint8_t* m_base;
+    size_t m_mappedSize;
+    uint32_t m_slotCount;
+    uint32_t m_slotSize;
+    uint64_t m_sequence;
+    unsigned long m_oversized;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "loudness_meter.h"
+#include "telemetry_frame.h"
+#include "true_peak_meter.h"
+
+// Collects every metric produced during one capture tick and flushes them as a
+// single TelemetryFrame, so each tick costs one WebSocket send instead of one per
+// metric.
+//
+// With a rate cap, ticks that arrive before the next flush is due fold into the
+// pending frame: peaks keep their maximum, and loudness, correlation, EQ, channel
+// spectrum and vectorscope keep their latest values. Nothing a meter reported is lost, only
+// resampled to the flush rate.
+class TelemetryAggregator {
+public:
+    TelemetryAggregator() : m_channelCount(0), m_flushInterval(0), m_pendingFrames(0), m_sequence(0) {
+        clear();
+    }
+
+    // maxFramesPerSecond: 0 flushes on every tick.
+    void initialize(int channelCount, int sampleRate, int maxFramesPerSecond) {
+        m_channelCount = channelCount;
+        m_samplePeaks.assign(channelCount, 0.0f);
+        m_truePeaks.assign(channelCount, 0.0f);
+        m_truePeakHolds.assign(channelCount, 0.0f);
+        m_flushInterval = (maxFramesPerSecond > 0) ? sampleRate / maxFramesPerSecond : 0;
+        m_pendingFrames = 0;
+        clear();
+    }
+
+    void setPeaks(const std::vector<float>& samplePeaks, const TruePeakMeter& truePeakMeter,
+                  unsigned int leftChannel, unsigned int rightChannel) {
+        for (int ch = 0; ch < m_channelCount; ++ch) {
+            m_samplePeaks[ch] = std::max(m_samplePeaks[ch], samplePeaks[ch]);
+            m_truePeaks[ch] = std::max(m_truePeaks[ch], truePeakMeter.peak(ch));
+            m_truePeakHolds[ch] = truePeakMeter.hold(ch);
+        }
+        m_leftChannel = leftChannel;
+        m_rightChannel = rightChannel;
+        m_hasPeaks = true;
+    }
+
+    void setLoudness(const LoudnessReading& reading) {
+        storeReading(reading, m_loudness);
+        m_hasLoudness = true;
+    }
+
+    void setPairCount(size_t pairCount) {
+        m_pairLoudness.resize(pairCount * 6);
+    }
+
+    // reading may be null for a pair that has no momentary value yet.
+    void setPairLoudness(size_t pair, unsigned int leftChannel, unsigned int rightChannel, const LoudnessReading* reading) {
+        float* values = &m_pairLoudness[pair * 6];
+        values[0] = leftChannel;
+        values[1] = rightChannel;
+        if (reading) {
+            storeReading(*reading, values + 2);
+        } else {
+            std::fill(values + 2, values + 6, NAN);
+        }
+        m_hasPairLoudness = true;
+    }
+
+    void setCorrelation(float correlation) {
+        m_correlation = correlation;
+        m_hasCorrelation = true;
+    }
+
+    void setEq(const std::vector<float>& bands) {
+        m_eq = bands;
+        m_hasEq = true;
+    }
+
+    // Upper triangle of the inter-channel correlation matrix, row by row.
+    void setCorrelationMatrix(const std::vector<float>& values) {
+        m_correlationMatrix = values;
+        m_hasCorrelationMatrix = true;
+    }
+
+    // levels holds bandCount values per channel.
+    void setChannelSpectrum(int bandCount, const std::vector<int16_t>& levels) {
+        m_channelSpectrum.resize(levels.size() + 1);
+        m_channelSpectrum[0] = (int16_t)bandCount;
+        std::copy(levels.begin(), levels.end(), m_channelSpectrum.begin() + 1);
+        m_hasChannelSpectrum = true;
+    }
+
+    // Points of the selected pair at the given sample positions.
+    void setVectorscope(const float* left, const float* right, const std::vector<unsigned int>& indices) {
+        m_vectorscope.resize(indices.size() * 2);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            m_vectorscope[2 * i] = toInt16(left[indices[i]]);
+            m_vectorscope[2 * i + 1] = toInt16(right[indices[i]]);
+        }
+        m_hasVectorscope = true;
+    }
+
+    // Closes a tick of frameCount samples. Returns true when a flush is due;
+    // frame() then holds everything gathered since the previous flush.
+    bool endTick(unsigned int frameCount) {
+        m_pendingFrames += frameCount;
+        if (m_pendingFrames < m_flushInterval) {
+            return false;
+        }
+        m_pendingFrames = 0;
+        buildFrame();
+        clear();
+        return !m_frame.empty();
+    }
+
+    const TelemetryFrame& frame() const {
+        return m_frame;
+    }
+
+private:
+    // Values a reading doesn't have yet are sent as NaN.
+    static void storeReading(const LoudnessReading& reading, float* values) {
+        values[0] = reading.momentary;
+        values[1] = reading.hasShortTerm ? reading.shortTerm : NAN;
+        values[2] = reading.hasIntegrated ? reading.integrated : NAN;
+        values[3] = reading.hasLoudnessRange ? reading.loudnessRange : NAN;
+    }
+
+    // Level in dB (dBFS, or dBTP for true peaks), floored at -100.
+    static float linearToDb(float level) {
+        return (level > 0.0f) ? (20.0f * std::log10(level)) : -100.0f;
+    }
+
+    static int16_t toInt16(float sample) {
+        return (int16_t)std::lrint(std::clamp(sample, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    void buildFrame() {
+        m_frame.begin(m_sequence++);
+
+        if (m_hasPeaks) {
+            float* levels = m_frame.addFloatSection(TelemetryFrame::kLevels, m_channelCount + 2);
+            levels[0] = linearToDb(m_samplePeaks[m_leftChannel]);
+            levels[1] = linearToDb(m_samplePeaks[m_rightChannel]);
+            for (int ch = 0; ch < m_channelCount; ++ch) {
+                levels[ch + 2] = linearToDb(m_samplePeaks[ch]);
+            }
+
+            float* truePeak = m_frame.addFloatSection(TelemetryFrame::kTruePeak, m_channelCount);
+            float* truePeakHold = m_frame.addFloatSection(TelemetryFrame::kTruePeakHold, m_channelCount);
+            for (int ch = 0; ch < m_channelCount; ++ch) {
+                truePeak[ch] = linearToDb(m_truePeaks[ch]);
+                truePeakHold[ch] = linearToDb(m_truePeakHolds[ch]);
+            }
+        }
+
+        if (m_hasLoudness) {
+            std::copy(m_loudness, m_loudness + 4, m_frame.addFloatSection(TelemetryFrame::kLoudness, 4));
+        }
+
+        if (m_hasPairLoudness) {
+            std::copy(m_pairLoudness.begin(), m_pairLoudness.end(),
+                      m_frame.addFloatSection(TelemetryFrame::kPairLoudness, m_pairLoudness.size()));
+        }
+
+        if (m_hasVectorscope) {
+            std::copy(m_vectorscope.begin(), m_vectorscope.end(),
+                      m_frame.addInt16Section(TelemetryFrame::kVectorscope, m_vectorscope.size()));
+        }
+
+        if (m_hasCorrelation) {
+            m_frame.addFloatSection(TelemetryFrame::kCorrelation, 1)[0] = m_correlation;
+        }
+
+        if (m_hasCorrelationMatrix) {
+            std::copy(m_correlationMatrix.begin(), m_correlationMatrix.end(),
+                      m_frame.addFloatSection(TelemetryFrame::kCorrelationMatrix, m_correlationMatrix.size()));
+        }
+
+        if (m_hasEq) {
+            std::copy(m_eq.begin(), m_eq.end(), m_frame.addFloatSection(TelemetryFrame::kEq, m_eq.size()));
+        }
+
+        if (m_hasChannelSpectrum) {
+            std::copy(m_channelSpectrum.begin(), m_channelSpectrum.end(),
+                      m_frame.addInt16Section(TelemetryFrame::kChannelSpectrum, m_channelSpectrum.size()));
+        }
+    }
+
+    void clear() {
+        std::fill(m_samplePeaks.begin(), m_samplePeaks.end(), 0.0f);
+        std::fill(m_truePeaks.begin(), m_truePeaks.end(), 0.0f);
+        m_leftChannel = 0;
+        m_rightChannel = 0;
+        m_hasPeaks = false;
+        m_hasLoudness = false;
+        m_hasPairLoudness = false;
+        m_hasCorrelation = false;
+        m_hasCorrelationMatrix = false;
+        m_hasEq = false;
+        m_hasChannelSpectrum = false;
+        m_hasVectorscope = false;
+    }
+
+    int m_channelCount;
+    unsigned int m_flushInterval;
+    unsigned int m_pendingFrames;
+
+    TelemetryFrame m_frame;
+    uint32_t m_sequence;
+
+    std::vector<float> m_samplePeaks;
+    std::vector<float> m_truePeaks;
+    std::vector<float> m_truePeakHolds;
+    unsigned int m_leftChannel;
+    unsigned int m_rightChannel;
+    bool m_hasPeaks;
+
+    float m_loudness[4];
+    bool m_hasLoudness;
+
+    std::vector<float> m_pairLoudness;
+    bool m_hasPairLoudness;
+
+    float m_correlation;
+    bool m_hasCorrelation;
+
+    std::vector<float> m_correlationMatrix;
+    bool m_hasCorrelationMatrix;
+
+    std::vector<float> m_eq;
+    bool m_hasEq;
+
+    std::vector<int16_t> m_channelSpectrum;
+    bool m_hasChannelSpectrum;
+
+    std::vector<int16_t> m_vectorscope;
+    bool m_hasVectorscope;
+};
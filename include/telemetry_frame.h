@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "TelemetryFrame writes host-order values and assumes a little-endian host"
+#endif
+
+// Compact binary telemetry frame sent as one WebSocket binary message.
+// web/telemetry.js holds the matching decoder.
+//
+// Layout, all little-endian:
+//   header   u32 magic 'SLMT' | u16 version | u16 section count | u32 sequence
+//   section  u16 section id | u8 element type | u8 reserved | u32 element count
+//            followed by the elements, zero-padded to a multiple of 4 bytes
+//
+// Every header is a multiple of 4 bytes long, so float32 payloads stay aligned and
+// the browser can view them in place. Elements are written straight into the frame
+// buffer; nothing is formatted as text.
+class TelemetryFrame {
+public:
+    static const uint32_t kMagic = 0x544D4C53; // "SLMT"
+    static const uint16_t kVersion = 1;
+
+    enum ElementType : uint8_t {
+        kFloat32 = 1,
+        kInt16 = 2,
+    };
+
+    enum SectionId : uint16_t {
+        kLevels = 1,             // float32 dBFS: selected left, selected right, then every channel
+        kTruePeak = 2,           // float32 dBTP per channel for this packet
+        kTruePeakHold = 3,       // float32 dBTP per channel since integration started
+        kLoudness = 4,           // float32 M, S, I, LRA per completed 100 ms block; NaN when absent
+        kPairLoudness = 5,       // float32 left, right, M, S, I, LRA per metered pair; NaN when absent
+        kCorrelation = 6,        // float32 correlation of the selected pair
+        kEq = 7,                 // float32 band levels in dB
+        kVectorscope = 8,        // int16 x, y pairs of the selected pair, full scale 32767
+        kChannelSpectrum = 9,    // int16 band count, then that many band levels per channel in 0.01 dB
+        kCorrelationMatrix = 10, // float32 correlation of every channel pair i < j, row by row
+    };
+
+    TelemetryFrame() : m_sectionCount(0) {
+        m_bytes.reserve(16384);
+    }
+
+    void begin(uint32_t sequence) {
+        m_bytes.resize(kHeaderSize);
+        m_sectionCount = 0;
+        write32(0, kMagic);
+        write16(4, kVersion);
+        write16(6, 0);
+        write32(8, sequence);
+    }
+
+    // Appends a section and returns its element storage for the caller to fill.
+    // The pointer is valid until the next section is added.
+    float* addFloatSection(SectionId id, uint32_t count) {
+        return reinterpret_cast<float*>(addSection(id, kFloat32, count, sizeof(float)));
+    }
+
+    int16_t* addInt16Section(SectionId id, uint32_t count) {
+        return reinterpret_cast<int16_t*>(addSection(id, kInt16, count, sizeof(int16_t)));
+    }
+
+    bool empty() const {
+        return m_sectionCount == 0;
+    }
+
+    const uint8_t* data() const {
+        return m_bytes.data();
+    }
+
+    size_t size() const {
+        return m_bytes.size();
+    }
+
+private:
+    static const size_t kHeaderSize = 12;
+    static const size_t kSectionHeaderSize = 8;
+
+    uint8_t* addSection(SectionId id, ElementType type, uint32_t count, size_t elementSize) {
+        const size_t offset = m_bytes.size();
+        const size_t payload = (count * elementSize + 3) & ~(size_t)3;
+        m_bytes.resize(offset + kSectionHeaderSize + payload, 0);
+        write16(offset, id);
+        m_bytes[offset + 2] = type;
+        m_bytes[offset + 3] = 0;
+        write32(offset + 4, count);
+        write16(6, ++m_sectionCount);
+        return m_bytes.data() + offset + kSectionHeaderSize;
+    }
+
+    void write16(size_t offset, uint16_t value) {
+        memcpy(&m_bytes[offset], &value, sizeof(value));
+    }
+
+    void write32(size_t offset, uint32_t value) {
+        memcpy(&m_bytes[offset], &value, sizeof(value));
+    }
+
+    std::vector<uint8_t> m_bytes;
+    uint16_t m_sectionCount;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// ITU-R BS.1770-4 Annex 2 true-peak meter.
+//
+// Every channel is oversampled 4x with the 48-tap interpolation filter of the
+// recommendation, split into four 12-tap polyphase branches. The branches sit in the
+// four lanes of one SSE register, so each input sample costs 12 multiply-adds that
+// produce all four interpolated output samples at once. Each channel's plane is fed
+// after the packet is deinterleaved; the filter history of each channel persists
+// across packets, so peaks straddling a packet boundary are not missed.
+class TruePeakMeter {
+public:
+    static const int kMaxChannels = 16;
+
+    TruePeakMeter() : m_channelCount(0) {
+        initialize(0);
+    }
+
+    void initialize(int channelCount) {
+        m_channelCount = std::min(channelCount, (int)kMaxChannels);
+        reset();
+    }
+
+    // Clears the filter history, the packet peaks and the hold values.
+    void reset() {
+        for (int ch = 0; ch < kMaxChannels; ++ch) {
+            std::fill(m_history[ch], m_history[ch] + 2 * kTaps, 0.0f);
+            m_position[ch] = 0;
+            m_hold[ch] = 0.0f;
+        }
+        beginPacket();
+    }
+
+    void resetHold() {
+        std::fill(m_hold, m_hold + kMaxChannels, 0.0f);
+    }
+
+    void beginPacket() {
+        for (int ch = 0; ch < kMaxChannels; ++ch) {
+            std::fill(m_lanePeaks[ch], m_lanePeaks[ch] + kPhases, 0.0f);
+        }
+    }
+
+    // Folds the peaks of the packet into the hold values.
+    void endPacket() {
+        for (int ch = 0; ch < m_channelCount; ++ch) {
+            m_hold[ch] = std::max(m_hold[ch], peak(ch));
+        }
+    }
+
+    inline void process(int ch, float x) {
+        // The history is stored twice so that the 12 newest samples are always
+        // contiguous: history[position + k] is x[n - k].
+        int position = m_position[ch];
+        float* history = m_history[ch];
+        history[position] = x;
+        history[position + kTaps] = x;
+        const float* taps = history + position;
+        m_position[ch] = (position == 0) ? kTaps - 1 : position - 1;
+
+#if defined(__SSE__)
+        __m128 acc = _mm_mul_ps(_mm_load_ps(kCoefficients[0]), _mm_set1_ps(taps[0]));
+        for (int k = 1; k < kTaps; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(kCoefficients[k]), _mm_set1_ps(taps[k])));
+        }
+        const __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), acc);
+        _mm_store_ps(m_lanePeaks[ch], _mm_max_ps(_mm_load_ps(m_lanePeaks[ch]), magnitude));
+#else
+        for (int phase = 0; phase < kPhases; ++phase) {
+            float acc = 0.0f;
+            for (int k = 0; k < kTaps; ++k) {
+                acc += kCoefficients[k][phase] * taps[k];
+            }
+            m_lanePeaks[ch][phase] = std::max(m_lanePeaks[ch][phase], std::fabs(acc));
+        }
+#endif
+    }
+
+    void processPlane(int ch, const float* samples, unsigned int count) {
+        for (unsigned int i = 0; i < count; ++i) {
+            process(ch, samples[i]);
+        }
+    }
+
+    // Linear true peak of the current packet.
+    float peak(int ch) const {
+        const float* lanes = m_lanePeaks[ch];
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+
+    // Linear maximum true peak since the last hold reset.
+    float hold(int ch) const {
+        return m_hold[ch];
+    }
+
+private:
+    static const int kPhases = 4;
+    static const int kTaps = 12;
+
+    // kCoefficients[k][phase]: tap k of each polyphase branch.
+    alignas(16) static constexpr float kCoefficients[kTaps][kPhases] = {
+        {  0.0017089843750f, -0.0291748046875f, -0.0189208984375f, -0.0083007812500f },
+        {  0.0109863281250f,  0.0292968750000f,  0.0330810546875f,  0.0148925781250f },
+        { -0.0196533203125f, -0.0517578125000f, -0.0582275390625f, -0.0266113281250f },
+        {  0.0332031250000f,  0.0891113281250f,  0.1015625000000f,  0.0476074218750f },
+        { -0.0594482421875f, -0.1665039062500f, -0.2003173828125f, -0.1022949218750f },
+        {  0.1373291015625f,  0.4650878906250f,  0.7797851562500f,  0.9721679687500f },
+        {  0.9721679687500f,  0.7797851562500f,  0.4650878906250f,  0.1373291015625f },
+        { -0.1022949218750f, -0.2003173828125f, -0.1665039062500f, -0.0594482421875f },
+        {  0.0476074218750f,  0.1015625000000f,  0.0891113281250f,  0.0332031250000f },
+        { -0.0266113281250f, -0.0582275390625f, -0.0517578125000f, -0.0196533203125f },
+        {  0.0148925781250f,  0.0330810546875f,  0.0292968750000f,  0.0109863281250f },
+        { -0.0083007812500f, -0.0189208984375f, -0.0291748046875f,  0.0017089843750f },
+    };
+
+    int m_channelCount;
+    alignas(16) float m_lanePeaks[kMaxChannels][kPhases];
+    float m_history[kMaxChannels][2 * kTaps];
+    int m_position[kMaxChannels];
+    float m_hold[kMaxChannels];
+};
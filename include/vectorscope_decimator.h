@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// Reduces the stereo samples of a packet to a fixed vectorscope point budget.
+//
+// The packet is split into budget / 2 equal buckets of consecutive samples. Each
+// bucket keeps two points: the one furthest from the centre (transients, clipping)
+// and the one with the largest |L - R| (wide or out-of-phase content). When both are
+// the same sample it is kept once. Points stay in time order, so the trace drawn
+// between them still follows the signal. Packets within the budget pass unchanged.
+class VectorscopeDecimator {
+public:
+    VectorscopeDecimator() : m_budget(0) {}
+
+    // budget: maximum number of points per packet, rounded down to an even number
+    // but at least 2; 0 keeps every sample.
+    // maxCount: largest packet that will be decimated.
+    void initialize(unsigned int budget, unsigned int maxCount) {
+        m_budget = (budget == 1) ? 2 : (budget & ~1u);
+        m_indices.clear();
+        m_indices.reserve((m_budget == 0 || m_budget > maxCount) ? maxCount : m_budget);
+    }
+
+    // Fills indices() with the positions of the samples to draw.
+    void decimate(const float* left, const float* right, unsigned int count) {
+        m_indices.clear();
+        if (m_budget == 0 || count <= m_budget) {
+            for (unsigned int i = 0; i < count; ++i) {
+                m_indices.push_back(i);
+            }
+            return;
+        }
+
+        const unsigned int buckets = m_budget / 2;
+        for (unsigned int b = 0; b < buckets; ++b) {
+            const unsigned int begin = (unsigned int)((unsigned long)count * b / buckets);
+            const unsigned int end = (unsigned int)((unsigned long)count * (b + 1) / buckets);
+
+            unsigned int radiusIndex = begin;
+            unsigned int sideIndex = begin;
+            double maxRadius = -1.0;
+            double maxSide = -1.0;
+            for (unsigned int i = begin; i < end; ++i) {
+                const double radius = left[i] * left[i] + right[i] * right[i];
+                const double side = std::fabs(left[i] - right[i]);
+                if (radius > maxRadius) {
+                    maxRadius = radius;
+                    radiusIndex = i;
+                }
+                if (side > maxSide) {
+                    maxSide = side;
+                    sideIndex = i;
+                }
+            }
+
+            if (radiusIndex == sideIndex) {
+                m_indices.push_back(radiusIndex);
+            } else if (radiusIndex < sideIndex) {
+                m_indices.push_back(radiusIndex);
+                m_indices.push_back(sideIndex);
+            } else {
+                m_indices.push_back(sideIndex);
+                m_indices.push_back(radiusIndex);
+            }
+        }
+    }
+
+    const std::vector<unsigned int>& indices() const {
+        return m_indices;
+    }
+
+private:
+    unsigned int m_budget;
+    std::vector<unsigned int> m_indices;
+};
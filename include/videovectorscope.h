@@ -112,7 +112,9 @@ public:
         if (!packet) { std::cerr << "Could not allocate packet." << std::endl; return false; }
 
         // 4. Register WebRTC track
-        webrtc_handler->RegisterH264Track("video-vs","stream-vectorscope","video-vs", 44);
+        if (!webrtc_handler->RegisterH264Track("video-vs","stream-vectorscope","video-vs", 44)) {
+            std::cerr << "[Info] WebRTC track video-vs already registered, reusing it." << std::endl;
+        }
         std::cerr << "[Info] VideoVectorScope initialized successfully." << std::endl;
         initialized = true;
         return true;
@@ -115,7 +115,9 @@ public:
         if (!packet) { std::cerr << "Could not allocate packet." << std::endl; return false; }
 
         // 4. Register WebRTC track
-        webrtc_handler->RegisterH264Track("video-wf","stream-waveform","video-wf", 45);
+        if (!webrtc_handler->RegisterH264Track("video-wf","stream-waveform","video-wf", 45)) {
+            std::cerr << "[Info] WebRTC track video-wf already registered, reusing it." << std::endl;
+        }
         std::cerr << "[Info] VideoWaveform initialized successfully." << std::endl;
         initialized = true;
         return true;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork/join pool for per-packet audio work.
+//
+// run() spreads the indices of one batch over the workers and the calling thread
+// and returns only after every worker has finished with that batch, so the task
+// may reference packet-local state. With no workers it simply runs the batch inline.
+class WorkerPool {
+public:
+    WorkerPool() : m_task(nullptr), m_count(0), m_next(0), m_generation(0),
+                   m_finished(0), m_stopping(false) {}
+
+    ~WorkerPool() {
+        stop();
+    }
+
+    // Non-copyable
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start(int threadCount) {
+        stop();
+        m_stopping = false;
+        for (int i = 0; i < threadCount; ++i) {
+            m_threads.emplace_back(&WorkerPool::workerLoop, this, m_generation);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+    }
+
+    size_t size() const {
+        return m_threads.size();
+    }
+
+    void run(int count, const std::function<void(int)>& task) {
+        if (m_threads.empty() || count <= 1) {
+            for (int i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_count = count;
+            m_next = 0;
+            m_finished = 0;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        drain(task, count);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_finished == m_threads.size(); });
+        m_task = nullptr;
+    }
+
+private:
+    void drain(const std::function<void(int)>& task, int count) {
+        for (int i = m_next.fetch_add(1); i < count; i = m_next.fetch_add(1)) {
+            task(i);
+        }
+    }
+
+    void workerLoop(unsigned long seen) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+            if (m_stopping) {
+                return;
+            }
+            seen = m_generation;
+            const std::function<void(int)>* task = m_task;
+            const int count = m_count;
+
+            lock.unlock();
+            drain(*task, count);
+            lock.lock();
+
+            if (++m_finished == m_threads.size()) {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const std::function<void(int)>* m_task;
+    int m_count;
+    std::atomic<int> m_next;
+    unsigned long m_generation;
+    size_t m_finished;
+    bool m_stopping;
+};
@@ -15,20 +15,45 @@ const WEB_ROOT = path.join(__dirname, 'web');
 const rooms = new Map();
 const peers = new Map();
 
+// Capture connects with ?role=capture from the loopback interface. Only these sockets
+// may send telemetry, settings and signal info; commands are sent only to them.
+const captureSockets = new Set();
+
 // --- Existing Data Structures ---
 let isIntegrating = false;
 let captureProcess = null;
 let latestVectorscopeSamples = null;
 let latestSignalInfo = null;
 
+// Optional shared memory telemetry: set TELEMETRY_SHM to a name such as 'sdi-loudness'
+// and Capture writes its frames to /dev/shm/<name> instead of sending them here.
+const TELEMETRY_SHM = process.env.TELEMETRY_SHM || null;
+const SHM_POLL_INTERVAL_MS = 10;
+
 // Default settings
 let channelSettings = {
     leftAudioChannel: 0,
     rightAudioChannel: 1,
+    loudnessLayout: 'stereo',
     device: 0,
     mode: -1
 };
 
+const LOUDNESS_LAYOUTS = ['stereo', '5.1', '7.1'];
+const CAPTURE_CHANNELS = 16; // Capture is always started with -c 16
+
+function isLoopbackAddress(address) {
+    return address === '127.0.0.1' || address === '::1' || address === '::ffff:127.0.0.1';
+}
+
+// Returns the integer value of a number or numeric string within [min, max], or null.
+function parseIntegerSetting(value, min, max) {
+    if (value === null || value === '' || typeof value === 'boolean') return null;
+    const number = Number(value);
+    if (!Number.isInteger(number) || number < min || number > max) return null;
+    return number;
+}
+
 // --- WebRTC Helper Functions ---
 const getRoom = (room) => {
     if (!rooms.has(room)) {
@@ -101,6 +126,96 @@ function broadcastVectorscopeSamples(msgStr) {
     wss.clients.forEach(ws => sendVectorscopeSamplesToClient(ws, msgStr));
 }
 
+// Binary telemetry frames from Capture are relayed to audio pages untouched;
+// the browser decodes them (web/telemetry.js). Lagging clients skip frames.
+function relayTelemetryFrame(frame) {
+    wss.clients.forEach(ws => {
+        if (ws.readyState !== WebSocket.OPEN) return;
+        const meta = peers.get(ws);
+        if (!meta || meta.role !== 'sub' || meta.page !== 'audio') return;
+        if (ws.bufferedAmount > 512 * 1024) return;
+        ws.send(frame, { binary: true }, err => {
+            if (err) {
+                console.error('Failed to send telemetry frame to client:', err);
+                terminatePeer(ws, `send_error:${err.code || err.message}`);
+            }
+        });
+    });
+}
+
+// Reads the newest frame from the shared memory ring written by Capture
+// (layout in include/shm_telemetry.h). A frame is kept only if its slot
+// sequence is unchanged after the copy, i.e. Capture didn't overwrite it meanwhile.
+// The reads are asynchronous, so the event loop never waits on the file, and only
+// one poll is in flight at a time: a poll that finds the previous one still running
+// is skipped. Each poll reads the header, then the whole slot in one call, then the
+// slot sequence again.
+const SHM_MAGIC = 0x534D4C53; // "SLMS"
+const SHM_HEADER_SIZE = 64;
+const SHM_SLOT_HEADER_SIZE = 16;
+const shmHeader = Buffer.alloc(SHM_HEADER_SIZE);
+const shmSequenceCheck = Buffer.alloc(8);
+let shmSlot = Buffer.alloc(0);
+let shmFile = null;
+let shmLastSequence = 0n;
+let shmPollBusy = false;
+
+function resetShmTelemetry() {
+    if (shmFile !== null) {
+        shmFile.close().catch(() => { /* already closed */ });
+    }
+    shmFile = null;
+    shmLastSequence = 0n;
+}
+
+async function readShmFrame() {
+    if (shmFile === null) {
+        shmFile = await fs.promises.open(path.join('/dev/shm', TELEMETRY_SHM), 'r');
+    }
+    const file = shmFile;
+    await file.read(shmHeader, 0, SHM_HEADER_SIZE, 0);
+    if (shmHeader.readUInt32LE(0) !== SHM_MAGIC) return null;
+    const slotCount = shmHeader.readUInt32LE(8);
+    const slotSize = shmHeader.readUInt32LE(12);
+    const sequence = shmHeader.readBigUInt64LE(16);
+    if (sequence === 0n || sequence === shmLastSequence || slotCount === 0) return null;
+    if (slotSize <= SHM_SLOT_HEADER_SIZE) return null;
+
+    if (shmSlot.length !== slotSize) {
+        shmSlot = Buffer.alloc(slotSize);
+    }
+    const offset = SHM_HEADER_SIZE + Number(sequence % BigInt(slotCount)) * slotSize;
+    await file.read(shmSlot, 0, slotSize, offset);
+    if (shmSlot.readBigUInt64LE(0) !== sequence) return null;
+    const length = shmSlot.readUInt32LE(8);
+    if (length > slotSize - SHM_SLOT_HEADER_SIZE) return null;
+
+    await file.read(shmSequenceCheck, 0, 8, offset);
+    if (shmSequenceCheck.readBigUInt64LE(0) !== sequence) return null;
+
+    shmLastSequence = sequence;
+    return Buffer.from(shmSlot.subarray(SHM_SLOT_HEADER_SIZE, SHM_SLOT_HEADER_SIZE + length));
+}
+
+function pollShmTelemetry() {
+    if (shmPollBusy || !hasAudioSubscribers()) return;
+    shmPollBusy = true;
+    readShmFrame()
+        .then(frame => {
+            if (frame) relayTelemetryFrame(frame);
+        })
+        .catch(() => {
+            resetShmTelemetry(); // Capture not started yet, or the ring was recreated
+        })
+        .finally(() => {
+            shmPollBusy = false;
+        });
+}
+
+if (TELEMETRY_SHM) {
+    setInterval(pollShmTelemetry, SHM_POLL_INTERVAL_MS);
+}
+
 // --- System Stats (offloaded to worker) ---
 const statsWorker = fork(path.join(__dirname, 'web', 'statsWorker.js'));
 
@@ -122,6 +237,35 @@ statsWorker.on('exit', (code, signal) => {
     console.warn(`Stats worker exited code=${code} signal=${signal}`);
 });
 
+// Commands go to the Capture connection only.
+function sendCaptureCommand(msg) {
+    const msgStr = JSON.stringify(msg);
+    captureSockets.forEach(client => {
+        if (client.readyState === WebSocket.OPEN) {
+            client.send(msgStr);
+        }
+    });
+}
+
+function broadcastIntegrationState() {
+    const integrationStateMsg = JSON.stringify({ type: 'integration_state', is_integrating: isIntegrating });
+    wss.clients.forEach(client => {
+        const peer = peers.get(client);
+        if (peer && peer.page === 'audio' && client.readyState === WebSocket.OPEN) {
+            client.send(integrationStateMsg);
+        }
+    });
+}
+
+function broadcastSettings() {
+    const msgStr = JSON.stringify({ type: 'settings', ...channelSettings });
+    wss.clients.forEach(client => {
+        if (client.readyState === WebSocket.OPEN) {
+            client.send(msgStr);
+        }
+    });
+}
+
 // --- Capture Process Management ---
 function startCapture() {
     const spawnProcess = () => {
@@ -130,8 +274,13 @@ function startCapture() {
             '-m', channelSettings.mode,
             '-c', 16, // Always capture 16 channels
             '-L', channelSettings.leftAudioChannel,
-            '-R', channelSettings.rightAudioChannel
+            '-R', channelSettings.rightAudioChannel,
+            '-l', channelSettings.loudnessLayout
         ];
+        if (TELEMETRY_SHM) {
+            args.push('-S', TELEMETRY_SHM);
+            resetShmTelemetry();
+        }
 
         console.log(`Starting Capture with args: ${args.join(' ')}`);
         captureProcess = spawn(path.join(__dirname, 'Capture'), args);
@@ -183,34 +332,90 @@ app.get('/api/settings', (req, res) => {
     res.json(channelSettings);
 });
 
-app.post('/api/settings', (req, res) => {
-    const { leftChannel, rightChannel, device, mode } = req.body;
-    let shouldRestart = false;
+// Validates a settings change from a UI client and forwards it to Capture. Used by
+// POST /api/settings and by the select_pair and configure WebSocket commands.
+// Returns the HTTP status and response body.
+function updateSettings(request) {
+    const { leftChannel, rightChannel, layout, device, mode } = request;
+    const next = { ...channelSettings };
+    let shouldReconfigure = false;
+
+    if (leftChannel !== undefined || rightChannel !== undefined) {
+        const left = parseIntegerSetting(leftChannel, 0, CAPTURE_CHANNELS - 1);
+        const right = parseIntegerSetting(rightChannel, 0, CAPTURE_CHANNELS - 1);
+        if (left === null || right === null) {
+            return { status: 400, body: { success: false, message: `Channel pair must be two channels 0-${CAPTURE_CHANNELS - 1}.` } };
+        }
+        next.leftAudioChannel = left;
+        next.rightAudioChannel = right;
+    }
 
-    if (leftChannel !== undefined && rightChannel !== undefined) {
-        channelSettings.leftAudioChannel = parseInt(leftChannel, 10);
-        channelSettings.rightAudioChannel = parseInt(rightChannel, 10);
-        shouldRestart = true;
+    if (layout !== undefined) {
+        if (!LOUDNESS_LAYOUTS.includes(layout)) {
+            return { status: 400, body: { success: false, message: `Unknown loudness layout: ${layout}` } };
+        }
+        next.loudnessLayout = layout;
+        shouldReconfigure = true;
     }
 
     if (device !== undefined) {
-        channelSettings.device = parseInt(device, 10);
-        shouldRestart = true;
+        next.device = parseIntegerSetting(device, 0, 255);
+        if (next.device === null) {
+            return { status: 400, body: { success: false, message: 'Invalid device.' } };
+        }
+        shouldReconfigure = true;
     }
 
     if (mode !== undefined) {
-        channelSettings.mode = parseInt(mode, 10);
-        shouldRestart = true;
+        next.mode = parseIntegerSetting(mode, -1, 1023);
+        if (next.mode === null) {
+            return { status: 400, body: { success: false, message: 'Invalid mode.' } };
+        }
+        shouldReconfigure = true;
     }
 
-    if (!shouldRestart) {
-        res.status(400).json({ success: false, message: 'Invalid settings provided.' });
-        return;
+    if (!shouldReconfigure && (leftChannel === undefined || rightChannel === undefined)) {
+        return { status: 400, body: { success: false, message: 'Invalid settings provided.' } };
     }
 
+    const pairChanged = next.leftAudioChannel !== channelSettings.leftAudioChannel ||
+                        next.rightAudioChannel !== channelSettings.rightAudioChannel;
+    channelSettings = next;
     console.log('Updated channel settings:', channelSettings);
-    startCapture(); // Restart capture process with new settings
-    res.json({ success: true, message: 'Settings updated and Capture process restarted.' });
+    broadcastSettings();
+    if (!captureProcess) {
+        startCapture();
+        return { status: 200, body: { success: true, message: 'Settings updated and Capture process started.' } };
+    }
+
+    // Capture re-arms its inputs in-process; the meters, the WebSocket link and the
+    // WebRTC session survive. It answers with the settings it actually applied.
+    if (shouldReconfigure) {
+        sendCaptureCommand({
+            command: 'configure',
+            device: channelSettings.device,
+            mode: channelSettings.mode,
+            layout: channelSettings.loudnessLayout,
+            left: channelSettings.leftAudioChannel,
+            right: channelSettings.rightAudioChannel
+        });
+        return { status: 200, body: { success: true, message: 'Settings updated.' } };
+    }
+
+    // Every stereo pair is metered continuously, so switching pairs needs no restart.
+    if (pairChanged) {
+        sendCaptureCommand({
+            command: 'select_pair',
+            left: channelSettings.leftAudioChannel,
+            right: channelSettings.rightAudioChannel
+        });
+    }
+    return { status: 200, body: { success: true, message: 'Settings updated.' } };
+}
+
+app.post('/api/settings', (req, res) => {
+    const result = updateSettings(req.body || {});
+    res.status(result.status).json(result.body);
 });
 
 const DEVICE_CONFIGURE_PATH = path.join(__dirname, 'tools', 'deviceconfigure', 'DeviceConfigure');
@@ -347,12 +552,124 @@ app.post('/api/input-config/apply', async (req, res) => {
 });
 
 // --- WebSocket Handling ---
+
+// Commands from UI clients. Settings changes go through updateSettings, which
+// validates them before anything is sent to Capture.
+function handleClientCommand(ws, msg) {
+    switch (msg.command) {
+        case 'start_integration':
+        case 'stop_integration':
+            isIntegrating = msg.command === 'start_integration';
+            sendCaptureCommand({ command: msg.command });
+            broadcastIntegrationState();
+            break;
+        case 'select_pair': {
+            const result = updateSettings({ leftChannel: msg.left, rightChannel: msg.right });
+            if (!result.body.success) console.warn(`Rejected select_pair: ${result.body.message}`);
+            break;
+        }
+        case 'configure': {
+            const result = updateSettings({
+                leftChannel: msg.left, rightChannel: msg.right,
+                layout: msg.layout, device: msg.device, mode: msg.mode
+            });
+            if (!result.body.success) console.warn(`Rejected configure: ${result.body.message}`);
+            break;
+        }
+        case 'get_settings':
+            safeSend(ws, { type: 'settings', ...channelSettings });
+            safeSend(ws, { type: 'integration_state', is_integrating: isIntegrating });
+            if (latestSignalInfo && ws.readyState === WebSocket.OPEN) ws.send(latestSignalInfo);
+            break;
+        default:
+            break;
+    }
+}
+
+// Telemetry, settings and signal info from Capture.
+function handleCaptureMessage(message, isBinary) {
+    if (isBinary) {
+        relayTelemetryFrame(message);
+        return;
+    }
+
+    let msg;
+    try {
+        msg = JSON.parse(message.toString());
+    } catch (e) {
+        return;
+    }
+
+    if (msg.type === 'vectorscope_samples' && Array.isArray(msg.samples)) {
+        const msgStr = JSON.stringify({ type: 'vectorscope_samples', samples: msg.samples });
+        broadcastVectorscopeSamples(msgStr);
+    } else if (msg.type === 'settings') {
+        // Sent by Capture after a configure command, with the settings in effect.
+        for (const key of Object.keys(channelSettings)) {
+            if (msg[key] !== undefined) channelSettings[key] = msg[key];
+        }
+        broadcastSettings();
+    } else if (msg.type === 'configure_error') {
+        // Capture couldn't apply a configure command; a settings message with the
+        // values still in effect follows.
+        console.warn(`Capture rejected the new settings: ${msg.message}`);
+        const msgStr = JSON.stringify({ type: 'configure_error', message: String(msg.message || '') });
+        wss.clients.forEach(client => {
+            if (client.readyState === WebSocket.OPEN && !captureSockets.has(client)) {
+                client.send(msgStr);
+            }
+        });
+  } else if (msg.type === 'signal_info') {
+        const msgStr = JSON.stringify(msg);
+        latestSignalInfo = msgStr;
+        wss.clients.forEach(client => {
+            if (client.readyState === WebSocket.OPEN && !captureSockets.has(client)) {
+                client.send(msgStr);
+            }
+        });
+    } else {
+        // Broadcast audio telemetry only to audio clients
+        const audioTelemetryTypes = ['lkfs', 's_lkfs', 'i_lkfs', 'levels', 'correlation', 'eq', 'lra', 'pair_loudness', 'capture_stats'];
+        if (audioTelemetryTypes.includes(msg.type)) {
+            const msgStr = JSON.stringify(msg);
+            wss.clients.forEach(client => {
+                const peer = peers.get(client);
+                if (peer && peer.page === 'audio' && client.readyState === WebSocket.OPEN) {
+                    client.send(msgStr);
+                }
+            });
+        }
+    }
+}
+
 wss.on('connection', (ws, req) => {
     console.log('WebSocket client connected');
 
     // --- WebRTC Signaling Connection Logic ---
     const url = new URL(req.url, `http://${req.headers.host}`);
     const role = url.searchParams.get("role") || "sub";
+
+    if (role === 'capture') {
+        if (!isLoopbackAddress(req.socket.remoteAddress)) {
+            console.warn(`Rejected capture connection from ${req.socket.remoteAddress}`);
+            ws.close(1008, 'capture role is only accepted from loopback');
+            return;
+        }
+        captureSockets.add(ws);
+        console.log('[JOIN] Capture connected');
+        ws.on('message', (message, isBinary) => handleCaptureMessage(message, isBinary));
+        ws.on('close', () => {
+            captureSockets.delete(ws);
+            console.log('[LEAVE] Capture disconnected');
+        });
+        ws.on('error', (err) => {
+            console.error('Capture WebSocket error:', err);
+            captureSockets.delete(ws);
+            ws.terminate();
+        });
+        return;
+    }
+
     const room = url.searchParams.get("room") || "default";
     const page = url.searchParams.get("page") || "audio"; // Default to audio
     const id = randomUUID();
@@ -380,7 +697,10 @@ wss.on('connection', (ws, req) => {
         ws.send(latestSignalInfo);
     }
 
-    ws.on('message', message => {
+    ws.on('message', (message, isBinary) => {
+        // Telemetry frames are only accepted from Capture.
+        if (isBinary) return;
+
         let msg;
         try {
             const txt = message instanceof Buffer ? message.toString() : message;
@@ -408,53 +728,8 @@ wss.on('connection', (ws, req) => {
             }
         }
 
-        // --- Existing Message Handling ---
         if (msg.command) {
-            if (msg.command === 'start_integration') {
-                isIntegrating = true;
-            } else if (msg.command === 'stop_integration') {
-                isIntegrating = false;
-            }
-
-            // Broadcast command to all clients (the C++ app will listen for this)
-            wss.clients.forEach(client => {
-                if (client.readyState === WebSocket.OPEN) {
-                    client.send(JSON.stringify(msg));
-                }
-            });
-
-            const integrationStateMsg = JSON.stringify({ type: 'integration_state', is_integrating: isIntegrating });
-
-            // Broadcast integration state only to audio clients
-            wss.clients.forEach(client => {
-                const peer = peers.get(client);
-                if (peer && peer.page === 'audio' && client.readyState === WebSocket.OPEN) {
-                    client.send(integrationStateMsg);
-                }
-            });
-        } else if (msg.type === 'vectorscope_samples' && Array.isArray(msg.samples)) {
-            const msgStr = JSON.stringify({ type: 'vectorscope_samples', samples: msg.samples });
-            broadcastVectorscopeSamples(msgStr);
-        } else if (msg.type === 'signal_info') {
-            const msgStr = JSON.stringify(msg);
-            latestSignalInfo = msgStr;
-            wss.clients.forEach(client => {
-                if (client.readyState === WebSocket.OPEN) {
-                    client.send(msgStr);
-                }
-            });
-        } else {
-            // Broadcast audio telemetry only to audio clients
-            const audioTelemetryTypes = ['lkfs', 's_lkfs', 'i_lkfs', 'levels', 'correlation', 'eq', 'lra'];
-            if (audioTelemetryTypes.includes(msg.type)) {
-                const msgStr = JSON.stringify(msg);
-                wss.clients.forEach(client => {
-                    const peer = peers.get(client);
-                    if (peer && peer.page === 'audio' && client.readyState === WebSocket.OPEN) {
-                        client.send(msgStr);
-                    }
-                });
-            }
+            handleClientCommand(ws, msg);
         }
     });
 
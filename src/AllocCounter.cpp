@@ -0,0 +1,46 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Only linked into ALLOC_DEBUG builds and the allocation test (see the Makefile).
+
+static thread_local unsigned long t_allocationCount = 0;
+static std::atomic<unsigned long> g_allocationCount(0);
+
+unsigned long threadAllocationCount() {
+    return t_allocationCount;
+}
+
+unsigned long processAllocationCount() {
+    return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    ++t_allocationCount;
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -1,44 +1,210 @@
 #include "AudioProcessor.h"
-#include "LKFS.h"
-#include <sstream>
+#include "AllocCounter.h"
 #include <cmath>
 #include <numeric>
 #include <iostream>
 #include <algorithm>
 
-AudioProcessor::AudioProcessor() : m_isIntegrating(false) {
+// Member channels and BS.1770 weights of the configured programme loudness layout.
+// LFE carries a zero weight and is dropped by LoudnessMeter.
+static int loudnessGroupChannels(const BMDConfig& config, unsigned int* channels, double* weights) {
+    static const double kSurroundWeights[] = { 1.0, 1.0, 1.0, 0.0, 1.41, 1.41, 1.41, 1.41 };
+
+    if (config.m_loudnessLayout == kLoudnessLayoutStereo) {
+        channels[0] = config.m_leftAudioChannel;
+        channels[1] = config.m_rightAudioChannel;
+        weights[0] = weights[1] = 1.0;
+        return 2;
+    }
+
+    const int count = BMDConfig::GetLoudnessLayoutChannelCount(config.m_loudnessLayout);
+    for (int i = 0; i < count; ++i) {
+        channels[i] = config.m_leftAudioChannel + i;
+        weights[i] = kSurroundWeights[i];
+    }
+    return count;
+}
+
+static std::vector<double> eqBandEdges(EqBandLayout layout) {
+    if (layout == kEqBandLayoutThirdOctave) {
+        return BandLayout::thirdOctaveEdges();
+    }
+    return BandLayout::logEdges(64, 20.0, 20000.0);
+}
+
+AudioProcessor::AudioProcessor() :
+    m_packetFrameCount(0),
+    m_activeMeterCount(0),
+    m_displayMeter(0),
+    m_isIntegrating(false),
+    m_pendingIntegration(kIntegrationUnchanged),
+    m_pendingPair(-1),
+    m_channelCount(0) {
 }
 
-bool AudioProcessor::initialize(const BMDConfig& config, std::function<void(const std::string&)> send_ws_message) {
+bool AudioProcessor::initialize(const BMDConfig& config, std::function<void(const void*, size_t)> send_ws_binary) {
     m_config = config;
-    m_send_ws_message = send_ws_message;
+    m_channelCount = m_config.m_audioChannels;
+    m_send_ws_binary = send_ws_binary;
+    m_telemetry.initialize(m_config.m_audioChannels, kAudioSampleRate, m_config.m_telemetryRate);
+
+    m_eqProcessor.initialize(m_config.m_eqOverlap, eqBandEdges(m_config.m_eqBandLayout), kMaxPacketFrames);
+    m_correlatorProcessor.initialize(kAudioSampleRate, m_config.m_correlationTime);
+    m_correlationMatrix.initialize(m_config.m_audioChannels, kAudioSampleRate, m_config.m_correlationMatrixRate);
+    m_channelSpectrum.initialize(m_config.m_audioChannels, kAudioSampleRate, m_config.m_channelSpectrumRate, kMaxPacketFrames);
+    m_vectorscopeDecimator.initialize(m_config.m_vectorscopePoints, kMaxPacketFrames);
+
+    if (!m_deinterleaver.initialize(m_config.m_audioChannels, m_config.m_audioSampleDepth)) {
+        fprintf(stderr, "Error: Unsupported audio sample depth %d\n", m_config.m_audioSampleDepth);
+        return false;
+    }
+    m_planeBuffer.assign((size_t)kMaxPacketFrames * m_config.m_audioChannels, 0.0f);
+    m_planes.resize(m_config.m_audioChannels);
+    for (int ch = 0; ch < m_config.m_audioChannels; ++ch) {
+        m_planes[ch] = m_planeBuffer.data() + (size_t)ch * kMaxPacketFrames;
+    }
+    m_maxLevels.assign(m_config.m_audioChannels, 0.0f);
+
+    unsigned int channels[LoudnessMeter::kMaxChannels];
+    double weights[LoudnessMeter::kMaxChannels];
+    const int groupSize = loudnessGroupChannels(m_config, channels, weights);
+    for (int i = 0; i < groupSize; ++i) {
+        if (channels[i] >= (unsigned int)m_config.m_audioChannels) {
+            fprintf(stderr, "Error: Loudness channel %u is out of range (%d channels)\n", channels[i], m_config.m_audioChannels);
+            return false;
+        }
+    }
+
+    // One meter per metered stereo pair, plus the programme group meter.
+    m_meterPairs.clear();
+    const int pairCount = m_config.m_audioChannels / 2;
+    for (int pair = 0; pair < pairCount; ++pair) {
+        if (m_config.m_meteredPairs & (1u << pair)) {
+            m_meterPairs.push_back(pair);
+        }
+    }
+    m_meters.assign(m_meterPairs.size() + 1, LoudnessMeter());
+    for (size_t i = 0; i < m_meterPairs.size(); ++i) {
+        const unsigned int pairChannels[2] = { (unsigned int)m_meterPairs[i] * 2, (unsigned int)m_meterPairs[i] * 2 + 1 };
+        const double pairWeights[2] = { 1.0, 1.0 };
+        m_meters[i].initialize(kAudioSampleRate, pairChannels, pairWeights, 2);
+        // On re-initialisation a running integration carries on with the new meters.
+        if (m_isIntegrating) {
+            m_meters[i].startIntegration();
+        }
+    }
+    m_telemetry.setPairCount(m_meterPairs.size());
+    m_pendingPair = -1;
+    selectDisplayMeter();
+    m_truePeakMeter.initialize(m_config.m_audioChannels);
 
-    m_eqProcessor.initialize();
+    m_meterTask = [this](int index) {
+        m_meters[index].processPlanes(m_planes.data(), m_packetFrameCount);
+    };
+    m_workerPool.start(m_config.m_meterThreads);
+
+    fprintf(stderr, "Measuring %s programme loudness from channel %d and %zu stereo pairs (%s PCM conversion).\n",
+            BMDConfig::GetLoudnessLayoutName(m_config.m_loudnessLayout), m_config.m_leftAudioChannel, m_meterPairs.size(),
+            m_deinterleaver.kernelName());
     return true;
 }
 
+// Publishes the metered pair matching the monitored L/R selection when there is
+// one; otherwise (re)starts the programme group meter for the configured layout.
+void AudioProcessor::selectDisplayMeter() {
+    const size_t programme = m_meters.size() - 1;
+    const unsigned int left = m_config.m_leftAudioChannel;
+    const unsigned int right = m_config.m_rightAudioChannel;
+
+    if (m_config.m_loudnessLayout == kLoudnessLayoutStereo && left % 2 == 0 && right == left + 1) {
+        for (size_t i = 0; i < m_meterPairs.size(); ++i) {
+            if (m_meterPairs[i] == (int)(left / 2)) {
+                m_displayMeter = i;
+                m_activeMeterCount = programme;
+                return;
+            }
+        }
+    }
+
+    unsigned int channels[LoudnessMeter::kMaxChannels];
+    double weights[LoudnessMeter::kMaxChannels];
+    const int groupSize = loudnessGroupChannels(m_config, channels, weights);
+    m_meters[programme].initialize(kAudioSampleRate, channels, weights, groupSize);
+    if (m_isIntegrating) {
+        m_meters[programme].startIntegration();
+    } else {
+        m_meters[programme].stopIntegration();
+    }
+    m_displayMeter = programme;
+    m_activeMeterCount = m_meters.size();
+}
+
 void AudioProcessor::startIntegration() {
     fprintf(stderr, "Received start integration command.\n");
-    m_momentaryLoudnessHistory.clear();
-    m_shortTermLoudnessHistory.clear();
-    m_isIntegrating = true;
+    m_pendingIntegration = kIntegrationStart;
 }
 
 void AudioProcessor::stopIntegration() {
     fprintf(stderr, "Received stop integration command.\n");
-    m_isIntegrating = false;
+    m_pendingIntegration = kIntegrationStop;
 }
 
-void AudioProcessor::processAudioPacket(IDeckLinkAudioInputPacket* audioFrame) {
-    if (!audioFrame) {
+bool AudioProcessor::selectPair(unsigned int leftChannel, unsigned int rightChannel) {
+    fprintf(stderr, "Received select pair command: %u/%u.\n", leftChannel, rightChannel);
+    // Channels are below 16, so both fit the 8-bit halves of the pending value.
+    const unsigned int channelCount = m_channelCount;
+    if (leftChannel >= channelCount || rightChannel >= channelCount) {
+        fprintf(stderr, "Error: Invalid audio channel selection. Left: %u, Right: %u, Total Channels: %u\n", leftChannel, rightChannel, channelCount);
+        return false;
+    }
+    m_pendingPair = (int)((leftChannel << 8) | rightChannel);
+    return true;
+}
+
+void AudioProcessor::applyPendingRequests() {
+    const int integration = m_pendingIntegration.exchange(kIntegrationUnchanged);
+    if (integration == kIntegrationStart) {
+        for (LoudnessMeter& meter : m_meters) {
+            meter.startIntegration();
+        }
+        m_truePeakMeter.resetHold();
+        m_isIntegrating = true;
+    } else if (integration == kIntegrationStop) {
+        for (LoudnessMeter& meter : m_meters) {
+            meter.stopIntegration();
+        }
+        m_isIntegrating = false;
+    }
+
+    const int pair = m_pendingPair.exchange(-1);
+    if (pair >= 0) {
+        const int left = pair >> 8;
+        const int right = pair & 0xFF;
+        if (left >= m_config.m_audioChannels || right >= m_config.m_audioChannels) {
+            fprintf(stderr, "Error: Invalid audio channel selection. Left: %d, Right: %d, Total Channels: %d\n", left, right, m_config.m_audioChannels);
+            return;
+        }
+        m_config.m_leftAudioChannel = left;
+        m_config.m_rightAudioChannel = right;
+        m_correlatorProcessor.reset();
+        // The programme group of a multichannel layout stays where it was configured.
+        if (m_config.m_loudnessLayout == kLoudnessLayoutStereo) {
+            selectDisplayMeter();
+        }
+    }
+}
+
+void AudioProcessor::processAudioPacket(const void* audioFrameBytes, unsigned int sampleFrameCount) {
+#ifdef ALLOC_DEBUG
+    AllocationCheck allocationCheck("processAudioPacket");
+#endif
+    if (!audioFrameBytes) {
         return;
     }
 
-    void* audioFrameBytes;
-    audioFrame->GetBytes(&audioFrameBytes);
-    const unsigned int sampleFrameCount = audioFrame->GetSampleFrameCount();
+    applyPendingRequests();
+
     const unsigned int channelCount = m_config.m_audioChannels;
-    const unsigned int sampleDepth = m_config.m_audioSampleDepth;
 
     const unsigned int leftChannel = m_config.m_leftAudioChannel;
     const unsigned int rightChannel = m_config.m_rightAudioChannel;
@@ -47,145 +213,63 @@ void AudioProcessor::processAudioPacket(IDeckLinkAudioInputPacket* audioFrame) {
         fprintf(stderr, "Error: Invalid audio channel selection. Left: %u, Right: %u, Total Channels: %u\n", leftChannel, rightChannel, channelCount);
         return;
     }
-
-    std::vector<double> maxLevels(channelCount, 0.0);
-    std::vector<double> current_left_samples;
-    std::vector<double> current_right_samples;
-    current_left_samples.reserve(sampleFrameCount);
-    current_right_samples.reserve(sampleFrameCount);
-
-    if (sampleDepth == 32) {
-        int32_t* pcmData = (int32_t*)audioFrameBytes;
-        for (unsigned int i = 0; i < sampleFrameCount; ++i) {
-            for (unsigned int ch = 0; ch < channelCount; ++ch) {
-                double sample = (double)pcmData[i * channelCount + ch] / 2147483648.0;
-                if (std::abs(sample) > maxLevels[ch]) {
-                    maxLevels[ch] = std::abs(sample);
-                }
-                if (ch == leftChannel) {
-                    m_leftChannelPcm.push_back(sample);
-                    m_shortTermLeftChannelPcm.push_back(sample);
-                    current_left_samples.push_back(sample);
-                }
-                if (ch == rightChannel) {
-                    m_rightChannelPcm.push_back(sample);
-                    m_shortTermRightChannelPcm.push_back(sample);
-                    current_right_samples.push_back(sample);
-                }
-            }
-        }
-    } else if (sampleDepth == 16) {
-        int16_t* pcmData = (int16_t*)audioFrameBytes;
-        for (unsigned int i = 0; i < sampleFrameCount; ++i) {
-            for (unsigned int ch = 0; ch < channelCount; ++ch) {
-                double sample = (double)pcmData[i * channelCount + ch] / 32768.0;
-                if (std::abs(sample) > maxLevels[ch]) {
-                    maxLevels[ch] = std::abs(sample);
-                }
-                if (ch == leftChannel) {
-                    m_leftChannelPcm.push_back(sample);
-                    m_shortTermLeftChannelPcm.push_back(sample);
-                    current_left_samples.push_back(sample);
-                }
-                if (ch == rightChannel) {
-                    m_rightChannelPcm.push_back(sample);
-                    m_shortTermRightChannelPcm.push_back(sample);
-                    current_right_samples.push_back(sample);
-                }
-            }
-        }
+    if (sampleFrameCount > kMaxPacketFrames) {
+        fprintf(stderr, "Error: Audio packet of %u frames exceeds %u frames\n", sampleFrameCount, kMaxPacketFrames);
+        return;
     }
 
-    double leftDb = (maxLevels[leftChannel] > 0.0) ? (20.0 * log10(maxLevels[leftChannel])) : -100.0;
-    double rightDb = (maxLevels[rightChannel] > 0.0) ? (20.0 * log10(maxLevels[rightChannel])) : -100.0;
-    std::ostringstream oss_levels;
-    oss_levels << "{\"type\": \"levels\", \"left\": " << leftDb << ", \"right\": " << rightDb << ", \"all\": [";
+    // One pass splits the packet into float planes and measures the sample peaks.
+    m_deinterleaver.process(audioFrameBytes, sampleFrameCount, m_planes.data(), m_maxLevels.data());
+    const float* leftSamples = m_planes[leftChannel];
+    const float* rightSamples = m_planes[rightChannel];
+
+    // True peak is a second pass over the planes, not part of the conversion pass: the
+    // oversampler's per-channel filter state doesn't fit the block-transposing
+    // kernels. The planes were just written, so this pass reads them from cache.
+    m_truePeakMeter.beginPacket();
     for (unsigned int ch = 0; ch < channelCount; ++ch) {
-        double db = (maxLevels[ch] > 0.0) ? (20.0 * log10(maxLevels[ch])) : -100.0;
-        oss_levels << db << (ch == channelCount - 1 ? "" : ",");
-    }
-    oss_levels << "]}";
-    m_send_ws_message(oss_levels.str());
-
-    while (m_leftChannelPcm.size() >= kWindowSizeInSamples) {
-        std::vector<double> leftWindow(m_leftChannelPcm.begin(), m_leftChannelPcm.begin() + kWindowSizeInSamples);
-        std::vector<double> rightWindow(m_rightChannelPcm.begin(), m_rightChannelPcm.begin() + kWindowSizeInSamples);
-        double lkfs = Momentary_loudness(leftWindow, rightWindow, kAudioSampleRate);
-        std::ostringstream oss;
-        oss << "{\"type\": \"lkfs\", \"value\": " << lkfs << "}";
-        m_send_ws_message(oss.str());
-        if(m_isIntegrating){
-            m_momentaryLoudnessHistory.push_back(lkfs);
-            double i_lkfs = integrated_loudness_with_momentaries(m_momentaryLoudnessHistory, kAudioSampleRate);
-            std::ostringstream oss_i;
-            oss_i << "{\"type\": \"i_lkfs\", \"value\": " << i_lkfs << "}";
-            m_send_ws_message(oss_i.str());
-        }
-        for (unsigned int i = 0; i < kSlideSizeInSamples; ++i) {
-            m_leftChannelPcm.pop_front();
-            m_rightChannelPcm.pop_front();
-        }
+        m_truePeakMeter.processPlane(ch, m_planes[ch], sampleFrameCount);
     }
+    m_truePeakMeter.endPacket();
+    m_telemetry.setPeaks(m_maxLevels, m_truePeakMeter, leftChannel, rightChannel);
 
-    while (m_shortTermLeftChannelPcm.size() >= kShortTermWindowSizeInSamples) {
-        std::vector<double> leftWindow(m_shortTermLeftChannelPcm.begin(), m_shortTermLeftChannelPcm.begin() + kShortTermWindowSizeInSamples);
-        std::vector<double> rightWindow(m_shortTermRightChannelPcm.begin(), m_shortTermRightChannelPcm.begin() + kShortTermWindowSizeInSamples);
-        double s_lkfs = ShortTerm_loudness(leftWindow, rightWindow, kAudioSampleRate);
-        std::ostringstream oss_s;
-        oss_s << "{\"type\": \"s_lkfs\", \"value\": " << s_lkfs << "}";
-        m_send_ws_message(oss_s.str());
-
-        if (m_isIntegrating) {
-            m_shortTermLoudnessHistory.push_back(s_lkfs);
-            
-            if (m_shortTermLoudnessHistory.size() > 1) { // Need at least 2 values for a range
-                double lra = LRA_with_shorts(m_shortTermLoudnessHistory);
-                std::ostringstream oss_lra;
-                oss_lra << "{\"type\": \"lra\", \"value\": " << lra << "}";
-                m_send_ws_message(oss_lra.str());
-            }
-        }
+    m_packetFrameCount = sampleFrameCount;
+    m_workerPool.run((int)m_activeMeterCount, m_meterTask);
 
-        for (unsigned int i = 0; i < kSlideSizeInSamples; ++i) {
-            m_shortTermLeftChannelPcm.pop_front();
-            m_shortTermRightChannelPcm.pop_front();
+    const std::vector<LoudnessReading>& readings = m_meters[m_displayMeter].readings();
+    if (!readings.empty()) {
+        m_telemetry.setLoudness(readings.back());
+    }
+    if (!m_meterPairs.empty() && !m_meters[0].readings().empty()) {
+        // The pair meters run in lockstep, so they all complete their blocks together.
+        for (size_t i = 0; i < m_meterPairs.size(); ++i) {
+            const std::vector<LoudnessReading>& pairReadings = m_meters[i].readings();
+            m_telemetry.setPairLoudness(i, m_meterPairs[i] * 2, m_meterPairs[i] * 2 + 1,
+                                        pairReadings.empty() ? nullptr : &pairReadings.back());
         }
     }
 
     if (sampleFrameCount > 0) {
-        sendVectorscopeSamples(current_left_samples, current_right_samples);
+        m_vectorscopeDecimator.decimate(leftSamples, rightSamples, sampleFrameCount);
+        m_telemetry.setVectorscope(leftSamples, rightSamples, m_vectorscopeDecimator.indices());
 
-        // Calculate and send correlation
-        std::vector<float> left_float(current_left_samples.begin(), current_left_samples.end());
-        std::vector<float> right_float(current_right_samples.begin(), current_right_samples.end());
-        float correlation = m_correlatorProcessor.process(left_float.data(), right_float.data(), sampleFrameCount);
-        std::ostringstream oss_corr;
-        oss_corr << "{\"type\": \"correlation\", \"value\": " << correlation << "}";
-        m_send_ws_message(oss_corr.str());
+        // Correlation of the selected pair, integrated over the configured time constant
+        m_telemetry.setCorrelation(m_correlatorProcessor.process(leftSamples, rightSamples, sampleFrameCount));
 
-        m_eqProcessor.processAudio(current_left_samples.data(), current_right_samples.data(), sampleFrameCount,
-            m_send_ws_message);
+        if (m_eqProcessor.processAudio(leftSamples, rightSamples, sampleFrameCount)) {
+            m_telemetry.setEq(m_eqProcessor.bands());
+        }
     }
-}
 
-void AudioProcessor::sendVectorscopeSamples(const std::vector<double>& leftSamples,
-                                            const std::vector<double>& rightSamples) {
-    if (leftSamples.empty() || rightSamples.empty()) return;
-    const size_t count = std::min(leftSamples.size(), rightSamples.size());
-    if (count == 0) return;
-
-    std::ostringstream oss;
-    oss << "{\"type\": \"vectorscope_samples\", \"samples\": [";
-    bool first = true;
-    for (size_t i = 0; i < count; ++i) {
-        const double x = std::clamp(leftSamples[i], -1.0, 1.0);
-        const double y = std::clamp(rightSamples[i], -1.0, 1.0);
-        if (!first) {
-            oss << ",";
-        }
-        first = false;
-        oss << "[" << x << "," << y << "]";
+    if (m_correlationMatrix.process(m_planes.data(), sampleFrameCount)) {
+        m_telemetry.setCorrelationMatrix(m_correlationMatrix.values());
+    }
+    if (m_channelSpectrum.process(m_planes.data(), sampleFrameCount)) {
+        m_telemetry.setChannelSpectrum(m_channelSpectrum.bandCount(), m_channelSpectrum.levels());
+    }
+
+    // Everything measured for this packet leaves as one frame.
+    if (m_telemetry.endTick(sampleFrameCount)) {
+        m_send_ws_binary(m_telemetry.frame().data(), m_telemetry.frame().size());
     }
-    oss << "]}";
-    m_send_ws_message(oss.str());
 }
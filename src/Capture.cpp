@@ -44,6 +44,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 #include <csignal>
 #include <vector>
 #include <deque>
@@ -52,11 +53,16 @@
 
 #include <websocketpp/config/asio_no_tls_client.hpp>
 #include <websocketpp/client.hpp>
+#include <nlohmann/json.hpp>
 
 #include "DeckLinkAPI.h"
 #include "Capture.h"
 #include "Config.h"
 #include "AudioProcessor.h"
+#include "audio_packet_ring.h"
+#include "outbound_queue.h"
+#include "shm_telemetry.h"
+#include "EmbeddedServer.h"
 
 #ifdef ENABLE_VIDEO_PROCESSING
 #include "VideoProcessor.h"
@@ -66,17 +72,43 @@
 typedef websocketpp::client<websocketpp::config::asio_client> client;
 using websocketpp::lib::bind;
 using websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2;
+using json = nlohmann::json;
 
 static client g_ws_client;
 static websocketpp::connection_hdl g_ws_hdl;
 static bool g_ws_connected = false;
 static pthread_mutex_t g_ws_mutex;
 static pthread_t g_ws_thread;
-static std::string g_ws_uri = "ws://127.0.0.1:8080";
+static std::string g_ws_uri = "ws://127.0.0.1:8080/?role=capture";
 static bool g_ws_started = false;
+
+// Every outbound message goes through this queue; only the writer thread sends.
+enum { kTopicAudioTelemetry, kTopicCount };
+static const size_t kOutboundEventCapacity = 64;
+static const unsigned int kOutboundStatsSeconds = 5;
+// Telemetry is skipped while the relay connection has more than this buffered,
+// so a stalled relay drops frames instead of growing websocketpp's send buffer.
+static const size_t kRelayMaxBufferedBytes = 512 * 1024;
+static OutboundQueue g_outbound;
+static pthread_t g_writerThread;
+static bool g_writerStarted = false;
+
+// Optional built-in server (-W) that replaces the connection to the Node relay.
+static EmbeddedServer g_embeddedServer;
+static std::string g_latestSignalInfo;
+static bool g_isIntegrating = false;
+// Guarded by g_sleepMutex, like the g_config fields the command handler reads.
+static int g_selectedLeftChannel = 0;
+static int g_selectedRightChannel = 1;
+
+// Optional shared memory transport for audio telemetry (-S).
+static const uint32_t kShmTelemetrySlots = 8;
+static const uint32_t kShmTelemetrySlotSize = 64 * 1024;
+static ShmTelemetryWriter g_shmTelemetry;
 static bool		 g_do_exit = false;
 
 static void send_ws_message(const std::string& msg);
+static void send_ws_binary(const void* data, size_t size);
 
 // Processors
 static AudioProcessor g_audioProcessor;
@@ -84,11 +116,36 @@ static AudioProcessor g_audioProcessor;
 static VideoProcessor g_videoProcessor;
 #endif
 
+// Audio packets are handed from the DeckLink callback to the DSP thread through this ring.
+static AudioPacketRing g_audioRing;
+static pthread_t g_audioThread;
+static bool g_audioThreadStarted = false;
+static const unsigned int kAudioRingSlots = 16;
+
 static pthread_mutex_t	 g_sleepMutex;
 static pthread_cond_t	 g_sleepCond;
 static BMDConfig		 g_config;
 static IDeckLinkInput*		 g_deckLinkInput = NULL;
 
+// What a configure command can change without restarting Capture. The command handler
+// queues the requested settings and wakes the main loop, which applies them between
+// StopStreams and re-arming the inputs.
+struct CaptureSettings {
+    int deckLinkIndex;
+    int displayModeIndex;
+    BMDPixelFormat pixelFormat;
+    int audioChannels;
+    int leftAudioChannel;
+    int rightAudioChannel;
+    LoudnessLayout loudnessLayout;
+};
+// Guarded by g_sleepMutex. The main thread also takes it to change g_config while
+// the command handler may be reading it.
+static CaptureSettings g_pendingSettings;
+static bool g_settingsPending = false;
+// Set by SIGHUP: re-arm the streams with the current settings.
+static bool g_rearmRequested = false;
+
 static void publishSignalInfo(IDeckLinkDisplayMode* mode, BMDPixelFormat pixelFormat)
 {
     if (!mode)
@@ -103,6 +160,9 @@ static void publishSignalInfo(IDeckLinkDisplayMode* mode, BMDPixelFormat pixelFo
     oss << "\"pixel_format\":\"" << g_config.GetPixelFormatName(pixelFormat) << "\"}";
     oss << "}";
 
+    pthread_mutex_lock(&g_ws_mutex);
+    g_latestSignalInfo = oss.str();
+    pthread_mutex_unlock(&g_ws_mutex);
     send_ws_message(oss.str());
 
     if (displayModeName)
@@ -122,17 +182,94 @@ void* ws_thread_func(void* /*arg*/) {
     return NULL;
 }
 
+// Drains the audio ring. All audio DSP and telemetry runs here, off the DeckLink callback.
+void* audio_thread_func(void* /*arg*/) {
+    unsigned long reportedOverruns = 0;
+    const AudioPacketRing::Packet* packet;
+    while ((packet = g_audioRing.wait()) != NULL) {
+        g_audioProcessor.processAudioPacket(packet->bytes.data(), packet->frameCount);
+        g_audioRing.pop();
+
+        const unsigned long overruns = g_audioRing.overruns();
+        if (overruns != reportedOverruns) {
+            fprintf(stderr, "Audio ring overrun: %lu packets dropped so far\n", overruns);
+            reportedOverruns = overruns;
+        }
+    }
+    return NULL;
+}
+
 void send_ws_message(const std::string& msg) {
     if (g_do_exit) return;
+    g_outbound.push(msg.data(), msg.size(), false);
+}
+
+// Sends an audio telemetry frame (see telemetry_frame.h) as a binary message.
+// Only the newest frame is kept when the writer falls behind.
+void send_ws_binary(const void* data, size_t size) {
+    if (g_do_exit) return;
+    if (g_shmTelemetry.isOpen()) {
+        g_shmTelemetry.write(data, size);
+        return;
+    }
+    g_outbound.publish(kTopicAudioTelemetry, data, size, true);
+}
+
+// Returns false when a topic value was skipped because the relay is backed up.
+static bool write_ws_message(const OutboundQueue::Message& message) {
+    if (g_embeddedServer.isRunning()) {
+        g_embeddedServer.broadcast(message.payload, message.binary);
+        return true;
+    }
+
+    bool written = true;
     pthread_mutex_lock(&g_ws_mutex);
     if (g_ws_connected) {
         websocketpp::lib::error_code ec;
-        g_ws_client.send(g_ws_hdl, msg, websocketpp::frame::opcode::text, ec);
+        client::connection_ptr con = g_ws_client.get_con_from_hdl(g_ws_hdl, ec);
         if (ec) {
             fprintf(stderr, "WebSocket send failed: %s\n", ec.message().c_str());
+        } else if (message.topic && con->get_buffered_amount() > kRelayMaxBufferedBytes) {
+            written = false;
+        } else {
+            ec = con->send(message.payload.data(), message.payload.size(),
+                           message.binary ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text);
+            if (ec) {
+                fprintf(stderr, "WebSocket send failed: %s\n", ec.message().c_str());
+            }
         }
     }
     pthread_mutex_unlock(&g_ws_mutex);
+    return written;
+}
+
+// Owns the sending side of the WebSocket connection. Every few seconds it also
+// reports the queue depth and drop counters as a capture_stats message.
+void* writer_thread_func(void* /*arg*/) {
+    OutboundQueue::Message message;
+    time_t lastStats = time(NULL);
+    while (g_outbound.take(message)) {
+        if (!write_ws_message(message)) {
+            g_outbound.skipped();
+        }
+
+        const time_t now = time(NULL);
+        if (now - lastStats >= kOutboundStatsSeconds) {
+            lastStats = now;
+            const OutboundQueue::Stats stats = g_outbound.stats();
+            std::ostringstream oss;
+            oss << "{\"type\":\"capture_stats\",\"queue_depth\":" << stats.depth
+                << ",\"sent\":" << stats.sent
+                << ",\"superseded\":" << stats.superseded
+                << ",\"dropped\":" << stats.dropped
+                << ",\"skipped\":" << stats.skipped
+                << ",\"audio_overruns\":" << g_audioRing.overruns()
+                << ",\"shm_oversized\":" << g_shmTelemetry.oversized() << "}";
+            OutboundQueue::Message statsMessage = { oss.str(), false };
+            write_ws_message(statsMessage);
+        }
+    }
+    return NULL;
 }
 
 void on_ws_open(client* c, websocketpp::connection_hdl hdl) {
@@ -152,13 +289,237 @@ void on_ws_close(client* c, websocketpp::connection_hdl hdl) {
     fflush(stderr);
 }
 
-void on_ws_message(client* c, websocketpp::connection_hdl hdl, client::message_ptr msg) {
-    std::string payload = msg->get_payload();
-    if (payload.find("\"command\"") != std::string::npos && payload.find("\"start_integration\"") != std::string::npos) {
+// Reads an integer field sent as a number or a numeric string ("left": 2 or "left": "2").
+// Returns false when the field is absent; a field that is present but not an
+// integer also sets error.
+static bool readIntField(const json& msg, const char* name, int& value, std::string& error) {
+    json::const_iterator field = msg.find(name);
+    if (field == msg.end()) return false;
+    if (field->is_number_integer()) {
+        value = field->get<int>();
+        return true;
+    }
+    if (field->is_string()) {
+        const std::string& text = field->get_ref<const std::string&>();
+        char* end;
+        long parsed = strtol(text.c_str(), &end, 10);
+        if (end != text.c_str() && *end == '\0') {
+            value = (int)parsed;
+            return true;
+        }
+    }
+    error = std::string("Invalid ") + name + ".";
+    return false;
+}
+
+static CaptureSettings current_settings() {
+    CaptureSettings settings;
+    pthread_mutex_lock(&g_sleepMutex);
+    settings.deckLinkIndex = g_config.m_deckLinkIndex;
+    settings.displayModeIndex = g_config.m_displayModeIndex;
+    settings.pixelFormat = g_config.m_pixelFormat;
+    settings.audioChannels = g_config.m_audioChannels;
+    settings.leftAudioChannel = g_selectedLeftChannel;
+    settings.rightAudioChannel = g_selectedRightChannel;
+    settings.loudnessLayout = g_config.m_loudnessLayout;
+    pthread_mutex_unlock(&g_sleepMutex);
+    return settings;
+}
+
+// Same fields as channelSettings in server.js.
+static std::string settings_json(bool withType) {
+    const CaptureSettings settings = current_settings();
+    std::ostringstream oss;
+    oss << "{";
+    if (withType) oss << "\"type\":\"settings\",";
+    oss << "\"leftAudioChannel\":" << settings.leftAudioChannel
+        << ",\"rightAudioChannel\":" << settings.rightAudioChannel
+        << ",\"loudnessLayout\":\"" << BMDConfig::GetLoudnessLayoutName(settings.loudnessLayout) << "\""
+        << ",\"device\":" << settings.deckLinkIndex
+        << ",\"mode\":" << settings.displayModeIndex << "}";
+    return oss.str();
+}
+
+// Tells the sender of a configure command why it wasn't applied. A settings
+// message with the values in effect follows it.
+static std::string configure_error_json(const std::string& message) {
+    return json{ { "type", "configure_error" }, { "message", message } }.dump();
+}
+
+static std::string integration_state_json() {
+    return std::string("{\"type\":\"integration_state\",\"is_integrating\":") + (g_isIntegrating ? "true" : "false") + "}";
+}
+
+static bool select_pair(int left, int right) {
+    pthread_mutex_lock(&g_sleepMutex);
+    const bool valid = left >= 0 && right >= 0 && left < g_config.m_audioChannels && right < g_config.m_audioChannels;
+    if (valid) {
+        g_selectedLeftChannel = left;
+        g_selectedRightChannel = right;
+    }
+    pthread_mutex_unlock(&g_sleepMutex);
+    return valid && g_audioProcessor.selectPair(left, right);
+}
+
+// Overlays the fields of a configure command on settings and checks the result the
+// way ParseArguments checks the command line. Fields: device, mode (-1 for format
+// detection), pixel_format (as -p), channels, left, right and layout.
+static bool parse_settings(const json& msg, CaptureSettings& settings, std::string& error) {
+    int value;
+    if (readIntField(msg, "device", value, error)) {
+        if (value < 0) error = "Invalid device.";
+        settings.deckLinkIndex = value;
+    }
+    if (readIntField(msg, "mode", value, error)) {
+        if (value < -1) error = "Invalid mode.";
+        settings.displayModeIndex = value;
+    }
+    if (readIntField(msg, "pixel_format", value, error) && !BMDConfig::GetPixelFormat(value, settings.pixelFormat)) {
+        error = "Invalid pixel_format.";
+    }
+    if (readIntField(msg, "channels", value, error)) {
+        if (value != 2 && value != 8 && value != 16) error = "channels must be 2, 8 or 16.";
+        settings.audioChannels = value;
+    }
+    readIntField(msg, "left", settings.leftAudioChannel, error);
+    readIntField(msg, "right", settings.rightAudioChannel, error);
+    json::const_iterator layout = msg.find("layout");
+    if (layout != msg.end() &&
+        (!layout->is_string() || !BMDConfig::ParseLoudnessLayout(layout->get_ref<const std::string&>().c_str(), settings.loudnessLayout))) {
+        error = "Invalid layout.";
+    }
+    if (!error.empty()) {
+        return false;
+    }
+
+    if (settings.leftAudioChannel < 0 || settings.leftAudioChannel >= settings.audioChannels ||
+        settings.rightAudioChannel < 0 || settings.rightAudioChannel >= settings.audioChannels) {
+        error = "Channel pair is out of range.";
+        return false;
+    }
+    if (settings.loudnessLayout != kLoudnessLayoutStereo &&
+        settings.leftAudioChannel + BMDConfig::GetLoudnessLayoutChannelCount(settings.loudnessLayout) > settings.audioChannels) {
+        error = "Layout doesn't fit the channel count.";
+        return false;
+    }
+    return true;
+}
+
+// The channel count and layout decide the meters; a multichannel layout also starts
+// its programme group at the left channel. Called from the main thread, or with
+// g_sleepMutex held.
+static bool audio_settings_changed(const CaptureSettings& settings) {
+    return settings.audioChannels != g_config.m_audioChannels ||
+           settings.loudnessLayout != g_config.m_loudnessLayout ||
+           (settings.loudnessLayout != kLoudnessLayoutStereo && settings.leftAudioChannel != g_config.m_leftAudioChannel);
+}
+
+// A new monitored pair is switched straight away; anything else is queued for the
+// main loop, which re-arms the streams without touching the WebSocket connection.
+static void request_settings(const CaptureSettings& settings) {
+    pthread_mutex_lock(&g_sleepMutex);
+    const bool rearm = settings.deckLinkIndex != g_config.m_deckLinkIndex ||
+                       settings.displayModeIndex != g_config.m_displayModeIndex ||
+                       settings.pixelFormat != g_config.m_pixelFormat ||
+                       audio_settings_changed(settings);
+    if (rearm) {
+        g_pendingSettings = settings;
+        g_settingsPending = true;
+        pthread_cond_signal(&g_sleepCond);
+    }
+    pthread_mutex_unlock(&g_sleepMutex);
+
+    if (!rearm) {
+        select_pair(settings.leftAudioChannel, settings.rightAudioChannel);
+        send_ws_message(settings_json(true));
+    }
+}
+
+// Commands from the relay, or from browsers when the embedded server is running.
+// In embedded mode Capture also answers what server.js would: settings and integration state.
+static void handle_command(const std::string& payload) {
+    const json msg = json::parse(payload, nullptr, false);
+    if (!msg.is_object()) {
+        return;
+    }
+    json::const_iterator field = msg.find("command");
+    if (field == msg.end() || !field->is_string()) {
+        return;
+    }
+    const std::string& command = field->get_ref<const std::string&>();
+
+    if (command == "start_integration") {
         g_audioProcessor.startIntegration();
-    } else if (payload.find("\"command\"") != std::string::npos && payload.find("\"stop_integration\"") != std::string::npos) {
+        g_isIntegrating = true;
+        if (g_embeddedServer.isRunning()) send_ws_message(integration_state_json());
+    } else if (command == "stop_integration") {
         g_audioProcessor.stopIntegration();
+        g_isIntegrating = false;
+        if (g_embeddedServer.isRunning()) send_ws_message(integration_state_json());
+    } else if (command == "select_pair") {
+        int left, right;
+        std::string error;
+        if (readIntField(msg, "left", left, error) && readIntField(msg, "right", right, error)) {
+            select_pair(left, right);
+        }
+    } else if (command == "configure") {
+        CaptureSettings settings = current_settings();
+        std::string error;
+        if (parse_settings(msg, settings, error)) {
+            request_settings(settings);
+        } else {
+            fprintf(stderr, "Rejected configure command: %s\n", error.c_str());
+            // Lets the sender fall back to the settings actually in use.
+            send_ws_message(configure_error_json(error));
+            send_ws_message(settings_json(true));
+        }
+    } else if (command == "get_settings" && g_embeddedServer.isRunning()) {
+        send_ws_message(settings_json(true));
+        send_ws_message(integration_state_json());
+        pthread_mutex_lock(&g_ws_mutex);
+        const std::string signalInfo = g_latestSignalInfo;
+        pthread_mutex_unlock(&g_ws_mutex);
+        if (!signalInfo.empty()) send_ws_message(signalInfo);
+    }
+}
+
+// The embedded server's /api/ routes. POST /api/settings takes the body server.js
+// accepts and applies it like a configure command.
+static std::string handle_api(const std::string& method, const std::string& resource, const std::string& body, int& status) {
+    if (resource == "/api/settings" && method == "GET") {
+        status = 200;
+        return settings_json(false);
+    }
+    if (resource == "/api/settings" && method == "POST") {
+        static const char* const kFieldNames[][2] = {
+            { "leftChannel", "left" }, { "rightChannel", "right" }, { "layout", "layout" },
+            { "device", "device" }, { "mode", "mode" }
+        };
+        const json request = json::parse(body, nullptr, false);
+        std::string error = "Invalid settings provided.";
+        if (request.is_object()) {
+            json msg = json::object();
+            for (const auto& names : kFieldNames) {
+                json::const_iterator field = request.find(names[0]);
+                if (field != request.end()) msg[names[1]] = *field;
+            }
+            CaptureSettings settings = current_settings();
+            error.clear();
+            if (parse_settings(msg, settings, error)) {
+                request_settings(settings);
+                status = 200;
+                return "{\"success\":true,\"message\":\"Settings updated.\"}";
+            }
+        }
+        status = 400;
+        return json{ { "success", false }, { "message", error } }.dump();
     }
+    status = 404;
+    return "{\"success\":false,\"message\":\"Not available in embedded server mode.\"}";
+}
+
+void on_ws_message(client* c, websocketpp::connection_hdl hdl, client::message_ptr msg) {
+    handle_command(msg->get_payload());
 }
 
 DeckLinkCaptureDelegate::DeckLinkCaptureDelegate() :
@@ -197,7 +558,10 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 
     if (audioFrame)
     {
-        g_audioProcessor.processAudioPacket(audioFrame);
+        // Only copy the packet here; a slow callback makes the driver drop frames.
+        void* audioFrameBytes;
+        audioFrame->GetBytes(&audioFrameBytes);
+        g_audioRing.push(audioFrameBytes, audioFrame->GetSampleFrameCount());
     }
 	return S_OK;
 }
@@ -250,18 +614,166 @@ static void sigfunc(int signum)
 {
 	if (signum == SIGINT || signum == SIGTERM)
 		 g_do_exit = true;
+	else
+		 g_rearmRequested = true;
 
 	pthread_cond_signal(&g_sleepCond);
 }
 
+// Format detection is enabled only for mode -1 on devices that support it.
+static BMDVideoInputFlags inputFlagsFor(IDeckLink* deckLink, int displayModeIndex)
+{
+	BMDVideoInputFlags flags = g_config.m_inputFlags & ~bmdVideoInputEnableFormatDetection;
+	IDeckLinkProfileAttributes* deckLinkAttributes = NULL;
+	bool formatDetectionSupported;
+
+	if (displayModeIndex == -1 &&
+		deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) == S_OK)
+	{
+		if (deckLinkAttributes->GetFlag(BMDDeckLinkSupportsInputFormatDetection, &formatDetectionSupported) == S_OK && formatDetectionSupported)
+			flags |= bmdVideoInputEnableFormatDetection;
+		deckLinkAttributes->Release();
+	}
+	return flags;
+}
+
+// Outcome of applySettings.
+enum ApplyResult {
+	kSettingsApplied,
+	kSettingsRejected,	// nothing that failed was kept; error says why
+	kAudioLost			// the previous audio setup couldn't be restored either
+};
+
+// Sets the device and display mode indices. The main thread is the only writer of
+// g_config, so it reads without the lock, but the command handler may be reading.
+static void setDeviceAndMode(int deckLinkIndex, int displayModeIndex)
+{
+	pthread_mutex_lock(&g_sleepMutex);
+	g_config.m_deckLinkIndex = deckLinkIndex;
+	g_config.m_displayModeIndex = displayModeIndex;
+	pthread_mutex_unlock(&g_sleepMutex);
+}
+
+// Applies queued configure settings while the streams are stopped. The device and
+// display mode are resolved first, so a device or mode that can't be opened leaves
+// the current settings in place. A new channel count or layout restarts the audio
+// thread with fresh meters; if the audio processor rejects them, the previous audio
+// settings are restored. The WebSocket connection, the writer thread and the WebRTC
+// session keep running throughout.
+static ApplyResult applySettings(const CaptureSettings& settings, IDeckLink*& deckLink, IDeckLinkDisplayMode*& displayMode, DeckLinkCaptureDelegate*& delegate, std::string& error)
+{
+	IDeckLink* newDeckLink = deckLink;
+	IDeckLinkInput* newInput = g_deckLinkInput;
+	IDeckLinkDisplayMode* newDisplayMode = NULL;
+	const int previousDeckLinkIndex = g_config.m_deckLinkIndex;
+	const int previousDisplayModeIndex = g_config.m_displayModeIndex;
+	ApplyResult result = kSettingsApplied;
+	char message[128];
+
+	setDeviceAndMode(settings.deckLinkIndex, settings.displayModeIndex);
+
+	if (settings.deckLinkIndex != previousDeckLinkIndex)
+	{
+		newDeckLink = g_config.GetSelectedDeckLink();
+		newInput = NULL;
+		if (newDeckLink == NULL || newDeckLink->QueryInterface(IID_IDeckLinkInput, (void**)&newInput) != S_OK)
+		{
+			snprintf(message, sizeof(message), "Unable to open input of DeckLink device %d", settings.deckLinkIndex);
+			goto fail;
+		}
+	}
+
+	newDisplayMode = g_config.GetSelectedDeckLinkDisplayMode(newDeckLink);
+	if (newDisplayMode == NULL)
+	{
+		snprintf(message, sizeof(message), "Display mode %d is not available on device %d", settings.displayModeIndex, settings.deckLinkIndex);
+		goto fail;
+	}
+
+	g_deckLinkInput->SetCallback(NULL);
+	if (newInput != g_deckLinkInput)
+	{
+		g_deckLinkInput->Release();
+		deckLink->Release();
+		g_deckLinkInput = newInput;
+		deckLink = newDeckLink;
+	}
+	displayMode->Release();
+	displayMode = newDisplayMode;
+	pthread_mutex_lock(&g_sleepMutex);
+	g_config.m_inputFlags = inputFlagsFor(deckLink, settings.displayModeIndex);
+	g_config.m_pixelFormat = settings.pixelFormat;
+	pthread_mutex_unlock(&g_sleepMutex);
+
+	// The delegate remembers the pixel format it was created with.
+	delegate->Release();
+	delegate = new DeckLinkCaptureDelegate();
+	g_deckLinkInput->SetCallback(delegate);
+
+	if (audio_settings_changed(settings))
+	{
+		const BMDConfig previous = g_config;
+		const int previousLeft = g_selectedLeftChannel;
+		const int previousRight = g_selectedRightChannel;
+
+		g_audioRing.stop();
+		pthread_join(g_audioThread, NULL);
+		g_audioThreadStarted = false;
+
+		pthread_mutex_lock(&g_sleepMutex);
+		g_config.m_audioChannels = settings.audioChannels;
+		g_config.m_loudnessLayout = settings.loudnessLayout;
+		g_config.m_leftAudioChannel = settings.leftAudioChannel;
+		g_config.m_rightAudioChannel = settings.rightAudioChannel;
+		g_selectedLeftChannel = settings.leftAudioChannel;
+		g_selectedRightChannel = settings.rightAudioChannel;
+		pthread_mutex_unlock(&g_sleepMutex);
+
+		if (!g_audioProcessor.initialize(g_config, send_ws_binary))
+		{
+			error = "The audio processor rejected the new channel count or layout.";
+			result = kSettingsRejected;
+
+			pthread_mutex_lock(&g_sleepMutex);
+			g_config.m_audioChannels = previous.m_audioChannels;
+			g_config.m_loudnessLayout = previous.m_loudnessLayout;
+			g_config.m_leftAudioChannel = previous.m_leftAudioChannel;
+			g_config.m_rightAudioChannel = previous.m_rightAudioChannel;
+			g_selectedLeftChannel = previousLeft;
+			g_selectedRightChannel = previousRight;
+			pthread_mutex_unlock(&g_sleepMutex);
+
+			if (!g_audioProcessor.initialize(g_config, send_ws_binary))
+				return kAudioLost;
+			g_audioProcessor.selectPair(previousLeft, previousRight);
+		}
+
+		g_audioRing.initialize(kAudioRingSlots, g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8), AudioProcessor::kMaxPacketFrames);
+		pthread_create(&g_audioThread, NULL, audio_thread_func, NULL);
+		g_audioThreadStarted = true;
+	}
+	else
+	{
+		select_pair(settings.leftAudioChannel, settings.rightAudioChannel);
+	}
+	return result;
+
+fail:
+	if (newInput != NULL && newInput != g_deckLinkInput)
+		newInput->Release();
+	if (newDeckLink != NULL && newDeckLink != deckLink)
+		newDeckLink->Release();
+	setDeviceAndMode(previousDeckLinkIndex, previousDisplayModeIndex);
+	error = message;
+	return kSettingsRejected;
+}
+
 int main(int argc, char *argv[])
 {
 	HRESULT result;
 	int exitStatus = 1;
 	IDeckLinkIterator* deckLinkIterator = NULL;
 	IDeckLink* deckLink = NULL;
-	IDeckLinkProfileAttributes* deckLinkAttributes = NULL;
-	bool formatDetectionSupported;
 	IDeckLinkDisplayMode* displayMode = NULL;
 	DeckLinkCaptureDelegate* delegate = NULL;
 
@@ -279,46 +791,64 @@ int main(int argc, char *argv[])
 		goto bail;
 	}
 
-    try {
-        g_ws_client.clear_access_channels(websocketpp::log::alevel::all);
-        g_ws_client.set_access_channels(websocketpp::log::alevel::connect | websocketpp::log::alevel::disconnect);
-        g_ws_client.set_error_channels(websocketpp::log::elevel::all);
-        g_ws_client.init_asio();
-        g_ws_client.set_open_handler(bind(&on_ws_open, &g_ws_client, ::_1));
-        g_ws_client.set_close_handler(bind(&on_ws_close, &g_ws_client, ::_1));
-        g_ws_client.set_message_handler(bind(&on_ws_message, &g_ws_client, ::_1, ::_2));
-        websocketpp::lib::error_code ec;
-        client::connection_ptr con = g_ws_client.get_connection(g_ws_uri, ec);
-        if (ec) { fprintf(stderr, "Could not create connection: %s\n", ec.message().c_str()); goto bail; }
-        g_ws_client.connect(con);
-        pthread_create(&g_ws_thread, NULL, ws_thread_func, NULL);
-        g_ws_started = true;
-    } catch (const std::exception & e) {
-        fprintf(stderr, "WebSocket setup exception: %s\n", e.what());
-        goto bail;
-    } catch (...) {
-        fprintf(stderr, "WebSocket setup unknown exception.\n");
-        goto bail;
+    g_selectedLeftChannel = g_config.m_leftAudioChannel;
+    g_selectedRightChannel = g_config.m_rightAudioChannel;
+    g_outbound.initialize(kTopicCount, kOutboundEventCapacity);
+    pthread_create(&g_writerThread, NULL, writer_thread_func, NULL);
+    g_writerStarted = true;
+
+    if (g_config.m_serverPort > 0) {
+        if (!g_embeddedServer.start(g_config.m_serverPort, g_config.m_webRoot, handle_command, handle_api)) {
+            fprintf(stderr, "Failed to start the embedded server on port %d\n", g_config.m_serverPort);
+            goto bail;
+        }
+    } else {
+        try {
+            g_ws_client.clear_access_channels(websocketpp::log::alevel::all);
+            g_ws_client.set_access_channels(websocketpp::log::alevel::connect | websocketpp::log::alevel::disconnect);
+            g_ws_client.set_error_channels(websocketpp::log::elevel::all);
+            g_ws_client.init_asio();
+            g_ws_client.set_open_handler(bind(&on_ws_open, &g_ws_client, ::_1));
+            g_ws_client.set_close_handler(bind(&on_ws_close, &g_ws_client, ::_1));
+            g_ws_client.set_message_handler(bind(&on_ws_message, &g_ws_client, ::_1, ::_2));
+            websocketpp::lib::error_code ec;
+            client::connection_ptr con = g_ws_client.get_connection(g_ws_uri, ec);
+            if (ec) { fprintf(stderr, "Could not create connection: %s\n", ec.message().c_str()); goto bail; }
+            g_ws_client.connect(con);
+            pthread_create(&g_ws_thread, NULL, ws_thread_func, NULL);
+            g_ws_started = true;
+        } catch (const std::exception & e) {
+            fprintf(stderr, "WebSocket setup exception: %s\n", e.what());
+            goto bail;
+        } catch (...) {
+            fprintf(stderr, "WebSocket setup unknown exception.\n");
+            goto bail;
+        }
     }
 
-	if (!g_audioProcessor.initialize(g_config, send_ws_message)) { 
+	if (g_config.m_telemetryShmName) {
+		if (!g_shmTelemetry.open(g_config.m_telemetryShmName, kShmTelemetrySlots, kShmTelemetrySlotSize)) {
+			fprintf(stderr, "Failed to open shared memory telemetry %s\n", g_config.m_telemetryShmName);
+			goto bail;
+		}
+		fprintf(stderr, "Writing audio telemetry to /dev/shm/%s\n", g_config.m_telemetryShmName);
+	}
+
+	if (!g_audioProcessor.initialize(g_config, send_ws_binary)) { 
 		fprintf(stderr, "Failed to initialize audio processor\n"); 
 		goto bail; 
 	}
 
+	g_audioRing.initialize(kAudioRingSlots, g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8), AudioProcessor::kMaxPacketFrames);
+	pthread_create(&g_audioThread, NULL, audio_thread_func, NULL);
+	g_audioThreadStarted = true;
+
 	deckLink = g_config.GetSelectedDeckLink();
 	if (deckLink == NULL) { fprintf(stderr, "Unable to get DeckLink device %u\n", g_config.m_deckLinkIndex); goto bail; }
 
 	if (deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&g_deckLinkInput) != S_OK) { fprintf(stderr, "The selected device does not have an input interface\n"); goto bail; }
 
-    if (g_config.m_displayModeIndex == -1) {
-        if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) == S_OK) {
-            if (deckLinkAttributes->GetFlag(BMDDeckLinkSupportsInputFormatDetection, &formatDetectionSupported) == S_OK && formatDetectionSupported) {
-                g_config.m_inputFlags |= bmdVideoInputEnableFormatDetection;
-            }
-            deckLinkAttributes->Release();
-        }
-    }
+    g_config.m_inputFlags = inputFlagsFor(deckLink, g_config.m_displayModeIndex);
 
     displayMode = g_config.GetSelectedDeckLinkDisplayMode(deckLink);
     if (displayMode == NULL) { fprintf(stderr, "Error: Could not find a valid display mode.\n"); goto bail; }
@@ -355,17 +885,50 @@ int main(int argc, char *argv[])
         exitStatus = 0;
 
         pthread_mutex_lock(&g_sleepMutex);
-        pthread_cond_wait(&g_sleepCond, &g_sleepMutex);
+        while (!g_do_exit && !g_rearmRequested && !g_settingsPending)
+            pthread_cond_wait(&g_sleepCond, &g_sleepMutex);
+        const bool reconfigure = g_settingsPending;
+        const CaptureSettings settings = g_pendingSettings;
+        g_settingsPending = false;
+        g_rearmRequested = false;
         pthread_mutex_unlock(&g_sleepMutex);
 
-        fprintf(stderr, "\nStopping capture...\n");
+        fprintf(stderr, g_do_exit ? "\nStopping capture...\n" : "\nRe-arming capture...\n");
         g_deckLinkInput->StopStreams();
         g_deckLinkInput->DisableAudioInput();
         g_deckLinkInput->DisableVideoInput();
+
+        if (reconfigure && !g_do_exit) {
+            std::string error;
+            const ApplyResult applied = applySettings(settings, deckLink, displayMode, delegate, error);
+            if (applied == kAudioLost) {
+                fprintf(stderr, "Failed to reinitialize audio processor\n");
+                exitStatus = 1;
+                goto bail;
+            }
+            if (applied == kSettingsRejected) {
+                fprintf(stderr, "Configure failed: %s\n", error.c_str());
+                send_ws_message(configure_error_json(error));
+            }
+            send_ws_message(settings_json(true));
+        }
     }
 
 
 bail:
+    if (g_deckLinkInput != NULL) g_deckLinkInput->SetCallback(NULL);
+    if (g_audioThreadStarted) {
+        g_audioRing.stop();
+        pthread_join(g_audioThread, NULL);
+    }
+
+    if (g_writerStarted) {
+        g_outbound.stop();
+        pthread_join(g_writerThread, NULL);
+    }
+
+    g_embeddedServer.stop();
+
     if (g_ws_started) {
         if (g_ws_connected) {
             websocketpp::lib::error_code ec;
@@ -375,6 +938,8 @@ bail:
         pthread_join(g_ws_thread, NULL);
     }
 
+	g_shmTelemetry.close();
+
 	if (displayMode != NULL) displayMode->Release();
 	if (delegate != NULL) delegate->Release();
 	if (g_deckLinkInput != NULL) { g_deckLinkInput->Release(); g_deckLinkInput = NULL; }
@@ -52,12 +52,25 @@ BMDConfig::BMDConfig() :
 	m_audioSampleDepth(16),
 	m_leftAudioChannel(0),
 	m_rightAudioChannel(1),
+	m_loudnessLayout(kLoudnessLayoutStereo),
+	m_meteredPairs(0xFF),
+	m_meterThreads(2),
+	m_vectorscopePoints(512),
+	m_telemetryRate(0),
+	m_eqOverlap(50),
+	m_eqBandLayout(kEqBandLayoutLog),
+	m_channelSpectrumRate(0),
+	m_correlationTime(1000),
+	m_correlationMatrixRate(0),
 	m_maxFrames(-1),
 	m_inputFlags(bmdVideoInputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_timecodeFormat(),
 	m_videoOutputFile(),
 	m_audioOutputFile(),
+	m_telemetryShmName(),
+	m_serverPort(0),
+	m_webRoot("web"),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -77,7 +90,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:L:R:")) != -1)
+	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:L:R:l:P:j:V:T:e:b:r:o:M:S:W:w:")) != -1)
 	{
 		switch (ch)
 		{
@@ -117,6 +130,23 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioOutputFile = optarg;
 				break;
 
+			case 'S':
+				m_telemetryShmName = optarg;
+				break;
+
+			case 'W':
+				m_serverPort = atoi(optarg);
+				if (m_serverPort <= 0 || m_serverPort > 65535)
+				{
+					fprintf(stderr, "Invalid argument: Server port must be between 1 and 65535\n");
+					return false;
+				}
+				break;
+
+			case 'w':
+				m_webRoot = optarg;
+				break;
+
 			case 'n':
 				m_maxFrames = atoi(optarg);
 				break;
@@ -126,14 +156,10 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				break;
 
 			case 'p':
-				switch(atoi(optarg))
+				if (!GetPixelFormat(atoi(optarg), m_pixelFormat))
 				{
-					case 0: m_pixelFormat = bmdFormat8BitYUV; break;
-					case 1: m_pixelFormat = bmdFormat10BitYUV; break;
-					case 2: m_pixelFormat = bmdFormat10BitRGB; break;
-					default:
-						fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
-						return false;
+					fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
+					return false;
 				}
 				break;
 
@@ -159,6 +185,109 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_rightAudioChannel = atoi(optarg);
 				break;
 
+			case 'l':
+				if (!ParseLoudnessLayout(optarg, m_loudnessLayout))
+				{
+					fprintf(stderr, "Invalid argument: Loudness layout \"%s\" is invalid\n", optarg);
+					return false;
+				}
+				break;
+
+			case 'P':
+				if (!strcmp(optarg, "all"))
+				{
+					m_meteredPairs = 0xFF;
+				}
+				else
+				{
+					char* cursor = optarg;
+					m_meteredPairs = 0;
+					while (*cursor)
+					{
+						char* end;
+						long pair = strtol(cursor, &end, 10);
+						if (end == cursor || pair < 0 || pair > 7)
+						{
+							fprintf(stderr, "Invalid argument: Metered pairs \"%s\" must be \"all\" or a list of pairs 0-7\n", optarg);
+							return false;
+						}
+						m_meteredPairs |= 1u << pair;
+						cursor = (*end == ',') ? end + 1 : end;
+					}
+				}
+				break;
+
+			case 'j':
+				m_meterThreads = atoi(optarg);
+				if (m_meterThreads < 0)
+				{
+					fprintf(stderr, "Invalid argument: Meter threads must not be negative\n");
+					return false;
+				}
+				break;
+
+			case 'V':
+				if (atoi(optarg) < 0)
+				{
+					fprintf(stderr, "Invalid argument: Vectorscope points must not be negative\n");
+					return false;
+				}
+				m_vectorscopePoints = atoi(optarg);
+				break;
+
+			case 'T':
+				m_telemetryRate = atoi(optarg);
+				if (m_telemetryRate < 0)
+				{
+					fprintf(stderr, "Invalid argument: Telemetry rate must not be negative\n");
+					return false;
+				}
+				break;
+
+			case 'e':
+				m_eqOverlap = atoi(optarg);
+				if (m_eqOverlap < 0 || m_eqOverlap > 90)
+				{
+					fprintf(stderr, "Invalid argument: EQ window overlap must be 0-90 percent\n");
+					return false;
+				}
+				break;
+
+			case 'b':
+				if (!ParseEqBandLayout(optarg, m_eqBandLayout))
+				{
+					fprintf(stderr, "Invalid argument: EQ band layout \"%s\" is invalid\n", optarg);
+					return false;
+				}
+				break;
+
+			case 'r':
+				m_channelSpectrumRate = atoi(optarg);
+				if (m_channelSpectrumRate < 0)
+				{
+					fprintf(stderr, "Invalid argument: Channel spectrum rate must not be negative\n");
+					return false;
+				}
+				break;
+
+			case 'o':
+				m_correlationTime = atoi(optarg);
+				if (m_correlationTime <= 0)
+				{
+					fprintf(stderr, "Invalid argument: Correlation time constant must be positive\n");
+					return false;
+				}
+				break;
+
+			case 'M':
+				m_correlationMatrixRate = atoi(optarg);
+				if (m_correlationMatrixRate < 0)
+				{
+					fprintf(stderr, "Invalid argument: Correlation matrix rate must not be negative\n");
+					return false;
+				}
+				break;
+
 			case '?':
 			case 'h':
 				displayHelp = true;
@@ -180,6 +309,20 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	if (displayHelp)
 		DisplayUsage(0);
 
+	if (m_loudnessLayout != kLoudnessLayoutStereo &&
+		m_leftAudioChannel + GetLoudnessLayoutChannelCount(m_loudnessLayout) > m_audioChannels)
+	{
+		fprintf(stderr, "Invalid argument: %s layout starting at channel %d needs more than %d audio channels\n",
+			GetLoudnessLayoutName(m_loudnessLayout), m_leftAudioChannel, m_audioChannels);
+		return false;
+	}
+
+	if (m_telemetryShmName != NULL && m_serverPort > 0)
+	{
+		fprintf(stderr, "Invalid argument: -S and -W cannot be combined, the embedded server would get no telemetry\n");
+		return false;
+	}
+
 	// Get device and display mode names
 	IDeckLink* deckLink = GetSelectedDeckLink();
 	if (deckLink != NULL)
@@ -456,6 +599,28 @@ bail:
 		"    -a <filename>        Filename raw audio will be written to\n"
 		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
+		"    -L <channel>         Left channel of the monitored pair (default is 0)\n"
+		"    -R <channel>         Right channel of the monitored pair (default is 1)\n"
+		"    -l <layout>          Loudness layout, starting at the left channel\n"
+		"         stereo: L/R pair (default)\n"
+		"         5.1:    L R C LFE Ls Rs\n"
+		"         7.1:    L R C LFE Ls Rs Lrs Rrs\n"
+		"    -P <pairs>           Stereo pairs metered simultaneously, e.g. 0,1,2 (default is all)\n"
+		"    -j <threads>         Worker threads for the pair meters (default is 2)\n"
+		"    -V <points>          Vectorscope points per packet, 0 sends every sample (default is 512)\n"
+		"    -T <rate>            Maximum telemetry frames per second, 0 sends one per audio packet (default is 0)\n"
+		"    -e <percent>         EQ analysis window overlap, e.g. 50 or 75 (default is 50)\n"
+		"    -b <bands>           EQ display bands\n"
+		"         log:          64 log-spaced bands, 20 Hz - 20 kHz (default)\n"
+		"         third-octave: 31 ISO third-octave bands\n"
+		"    -r <rate>            Third-octave spectrum of every channel, updates per second (default is 0, off)\n"
+		"    -o <ms>              Correlation meter time constant, e.g. 100 or 1000 (default is 1000)\n"
+		"    -M <rate>            Correlation between every channel pair, updates per second (default is 0, off)\n"
+		"    -S <name>            Write audio telemetry to the shared memory ring /dev/shm/<name>\n"
+		"                         instead of the WebSocket\n"
+		"    -W <port>            Serve the web pages and telemetry from Capture itself, without server.js\n"
+		"                         (no WebRTC video, system stats or input configuration)\n"
+		"    -w <dir>             Web root for -W (default is web)\n"
 		"    -n <frames>          Number of frames to capture (default is unlimited)\n"
 		"    -3                   Capture Stereoscopic 3D (Requires 3D Hardware support)\n"
 		"\n"
@@ -490,13 +655,15 @@ void BMDConfig::DisplayConfiguration()
 		" - Video mode: %s %s\n"
 		" - Pixel format: %s\n"
 		" - Audio channels: %u\n"
-		" - Audio sample depth: %u bit \n",
+		" - Audio sample depth: %u bit \n"
+		" - Loudness layout: %s\n",
 		m_deckLinkName,
 		m_displayModeName,
 		(m_inputFlags & bmdVideoInputDualStream3D) ? "3D" : "",
 		GetPixelFormatName(m_pixelFormat),
 		m_audioChannels,
-		m_audioSampleDepth
+		m_audioSampleDepth,
+		GetLoudnessLayoutName(m_loudnessLayout)
 	);
 }
 
@@ -514,3 +681,80 @@ const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
 	return "unknown";
 }
 
+// Maps the -p index to a pixel format.
+bool BMDConfig::GetPixelFormat(int index, BMDPixelFormat& pixelFormat)
+{
+	switch (index)
+	{
+		case 0: pixelFormat = bmdFormat8BitYUV; break;
+		case 1: pixelFormat = bmdFormat10BitYUV; break;
+		case 2: pixelFormat = bmdFormat10BitRGB; break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+const char* BMDConfig::GetLoudnessLayoutName(LoudnessLayout layout)
+{
+	switch (layout)
+	{
+		case kLoudnessLayoutStereo:
+			return "stereo";
+		case kLoudnessLayout5_1:
+			return "5.1";
+		case kLoudnessLayout7_1:
+			return "7.1";
+	}
+	return "unknown";
+}
+
+bool BMDConfig::ParseLoudnessLayout(const char* name, LoudnessLayout& layout)
+{
+	if (!strcmp(name, "stereo"))
+		layout = kLoudnessLayoutStereo;
+	else if (!strcmp(name, "5.1"))
+		layout = kLoudnessLayout5_1;
+	else if (!strcmp(name, "7.1"))
+		layout = kLoudnessLayout7_1;
+	else
+		return false;
+	return true;
+}
+
+int BMDConfig::GetLoudnessLayoutChannelCount(LoudnessLayout layout)
+{
+	switch (layout)
+	{
+		case kLoudnessLayoutStereo:
+			return 2;
+		case kLoudnessLayout5_1:
+			return 6;
+		case kLoudnessLayout7_1:
+			return 8;
+	}
+	return 2;
+}
+
+const char* BMDConfig::GetEqBandLayoutName(EqBandLayout layout)
+{
+	switch (layout)
+	{
+		case kEqBandLayoutLog:
+			return "log";
+		case kEqBandLayoutThirdOctave:
+			return "third-octave";
+	}
+	return "unknown";
+}
+
+bool BMDConfig::ParseEqBandLayout(const char* name, EqBandLayout& layout)
+{
+	if (!strcmp(name, "log"))
+		layout = kEqBandLayoutLog;
+	else if (!strcmp(name, "third-octave"))
+		layout = kEqBandLayoutThirdOctave;
+	else
+		return false;
+	return true;
+}
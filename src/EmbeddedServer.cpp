@@ -0,0 +1,171 @@
+#include "EmbeddedServer.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using websocketpp::lib::bind;
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+
+static const char* contentTypeFor(const std::string& path) {
+    const size_t dot = path.rfind('.');
+    const std::string ext = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+    if (ext == "html") return "text/html; charset=utf-8";
+    if (ext == "js") return "application/javascript; charset=utf-8";
+    if (ext == "css") return "text/css; charset=utf-8";
+    if (ext == "json") return "application/json";
+    if (ext == "png") return "image/png";
+    if (ext == "svg") return "image/svg+xml";
+    if (ext == "ico") return "image/x-icon";
+    return "application/octet-stream";
+}
+
+EmbeddedServer::EmbeddedServer() : m_running(false) {
+}
+
+EmbeddedServer::~EmbeddedServer() {
+    stop();
+}
+
+bool EmbeddedServer::start(uint16_t port, const std::string& webRoot, MessageHandler onMessage, ApiHandler onApi) {
+    m_webRoot = webRoot;
+    m_onMessage = onMessage;
+    m_onApi = onApi;
+
+    try {
+        m_server.clear_access_channels(websocketpp::log::alevel::all);
+        m_server.set_access_channels(websocketpp::log::alevel::connect | websocketpp::log::alevel::disconnect);
+        m_server.set_error_channels(websocketpp::log::elevel::warn | websocketpp::log::elevel::rerror | websocketpp::log::elevel::fatal);
+        m_server.init_asio();
+        m_server.set_reuse_addr(true);
+        m_server.set_http_handler(bind(&EmbeddedServer::onHttp, this, _1));
+        m_server.set_open_handler(bind(&EmbeddedServer::onOpen, this, _1));
+        m_server.set_close_handler(bind(&EmbeddedServer::onClose, this, _1));
+        m_server.set_message_handler(bind(&EmbeddedServer::onMessage, this, _1, _2));
+        m_server.listen(port);
+        m_server.start_accept();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Embedded server setup exception: %s\n", e.what());
+        return false;
+    }
+
+    pthread_create(&m_thread, NULL, threadFunc, this);
+    m_running = true;
+    fprintf(stderr, "Serving %s at http://0.0.0.0:%u\n", m_webRoot.c_str(), port);
+    return true;
+}
+
+void EmbeddedServer::stop() {
+    if (!m_running) return;
+
+    websocketpp::lib::error_code ec;
+    m_server.stop_listening(ec);
+    {
+        std::lock_guard<std::mutex> lock(m_connectionsMutex);
+        for (const websocketpp::connection_hdl& hdl : m_connections) {
+            m_server.close(hdl, websocketpp::close::status::going_away, "", ec);
+        }
+        m_connections.clear();
+    }
+    m_server.stop();
+    pthread_join(m_thread, NULL);
+    m_running = false;
+}
+
+void* EmbeddedServer::threadFunc(void* arg) {
+    EmbeddedServer* self = static_cast<EmbeddedServer*>(arg);
+    try {
+        self->m_server.run();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Embedded server thread exception: %s\n", e.what());
+    } catch (...) {
+        fprintf(stderr, "Embedded server thread unknown exception.\n");
+    }
+    return NULL;
+}
+
+void EmbeddedServer::broadcast(const std::string& payload, bool binary) {
+    const websocketpp::frame::opcode::value opcode =
+        binary ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text;
+
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    for (const websocketpp::connection_hdl& hdl : m_connections) {
+        websocketpp::lib::error_code ec;
+        server::connection_ptr con = m_server.get_con_from_hdl(hdl, ec);
+        if (ec) continue;
+        // Backpressure: a lagging browser skips telemetry frames until it catches up.
+        if (binary && con->get_buffered_amount() > kMaxBufferedBytes) continue;
+        con->send(payload.data(), payload.size(), opcode);
+    }
+}
+
+void EmbeddedServer::onOpen(websocketpp::connection_hdl hdl) {
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    m_connections.insert(hdl);
+}
+
+void EmbeddedServer::onClose(websocketpp::connection_hdl hdl) {
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    m_connections.erase(hdl);
+}
+
+void EmbeddedServer::onMessage(websocketpp::connection_hdl /*hdl*/, server::message_ptr msg) {
+    if (msg->get_opcode() == websocketpp::frame::opcode::text && m_onMessage) {
+        m_onMessage(msg->get_payload());
+    }
+}
+
+void EmbeddedServer::onHttp(websocketpp::connection_hdl hdl) {
+    server::connection_ptr con = m_server.get_con_from_hdl(hdl);
+    std::string resource = con->get_resource();
+    const size_t query = resource.find('?');
+    if (query != std::string::npos) {
+        resource.erase(query);
+    }
+
+    if (resource.compare(0, 5, "/api/") == 0) {
+        int status = 404;
+        std::string body = "{\"success\":false,\"message\":\"Not available in embedded server mode.\"}";
+        if (m_onApi) {
+            body = m_onApi(con->get_request().get_method(), resource, con->get_request_body(), status);
+        }
+        con->set_status(static_cast<websocketpp::http::status_code::value>(status));
+        con->append_header("Content-Type", "application/json");
+        con->set_body(body);
+        return;
+    }
+
+    std::string body;
+    std::string contentType;
+    if (readFile(resource, body, contentType)) {
+        con->set_status(websocketpp::http::status_code::ok);
+        con->append_header("Content-Type", contentType);
+        con->set_body(body);
+    } else {
+        con->set_status(websocketpp::http::status_code::not_found);
+        con->append_header("Content-Type", "text/plain");
+        con->set_body("Not found");
+    }
+}
+
+// Maps a request path to a file under the web root, with the same page routes as server.js.
+bool EmbeddedServer::readFile(const std::string& resource, std::string& body, std::string& contentType) {
+    std::string path = resource;
+    if (path == "/" || path.empty()) path = "/index.html";
+    else if (path == "/audio") path = "/audio.html";
+    else if (path == "/video") path = "/video.html";
+
+    if (path.find("..") != std::string::npos) {
+        return false;
+    }
+
+    std::ifstream file(m_webRoot + path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    body = oss.str();
+    contentType = contentTypeFor(path);
+    return true;
+}
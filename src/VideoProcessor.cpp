@@ -57,6 +57,10 @@ void VideoProcessor::cleanup() {
 
 
 bool VideoProcessor::initialize(int width, int height, BMDTimeValue timeScale, BMDTimeValue frameDuration, BMDPixelFormat pixelFormat) {
+    // Re-initialising for a new format keeps the WebRTC session, so connected viewers
+    // stay attached. Nothing unregisters the tracks, so the new encoders find their
+    // mids already registered and keep sending through the existing senders.
+    std::shared_ptr<WebRTC> webrtc = webrtc_handler;
     cleanup();
 
     sourcePixelFormat = get_ffmpeg_pixel_format(pixelFormat);
@@ -71,7 +75,7 @@ bool VideoProcessor::initialize(int width, int height, BMDTimeValue timeScale, B
     const AVRational framerate = {(int)timeScale, (int)frameDuration};
 
     try {
-        webrtc_handler = std::make_shared<WebRTC>("publisher");
+        webrtc_handler = webrtc ? webrtc : std::make_shared<WebRTC>("publisher");
 
         raw_video_processor = std::make_unique<RawVideoProcessor>();
         if (!raw_video_processor->initialize(dst_width, dst_height, time_base, framerate, webrtc_handler)) {
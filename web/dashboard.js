@@ -18,7 +18,7 @@
     const MAX_LKFS = -18;
     const MIN_DB_EQ = -40;
     const MAX_DB_EQ = 5;
-    const NUM_EQ_BANDS = 64;
+    const DEFAULT_EQ_BANDS = 64;
     const LRA_MAX = 25;
     const LEVEL_SCALE_POINTS = [0, -6, -12, -18, -24, -30, -40, -50, -60];
     const LKFS_SCALE_POINTS = [-18, -20, -22, -24, -26, -30, -35, -40];
@@ -101,10 +101,7 @@
             integrated: { latestValue: MIN_LKFS, displayValue: MIN_LKFS, label: '-inf' }
         },
         eq: {
-            bands: Array.from({ length: NUM_EQ_BANDS }, () => ({
-                latestValue: MIN_DB_EQ,
-                displayValue: MIN_DB_EQ
-            }))
+            bands: createEqBands(DEFAULT_EQ_BANDS)
         },
         correlator: { latestValue: 0, displayValue: 0 }
     };
@@ -822,7 +819,7 @@
         },
         eq: {
             title: 'EQ Meter',
-            description: '64-band loudness history',
+            description: 'A-weighted band spectrum',
             defaultSize: { w: 4, h: 3 },
             minW: 3,
             minH: 2,
@@ -1037,6 +1034,7 @@
         const panel = document.getElementById('channelSettingsPanel');
         const leftSelect = document.getElementById('channelSettingLeft');
         const rightSelect = document.getElementById('channelSettingRight');
+        const layoutSelect = document.getElementById('channelSettingLayout');
         const deviceSelect = document.getElementById('channelSettingDevice');
         const saveBtn = document.getElementById('channelSettingsSave');
         const metersContainer = document.getElementById('channelSettingsMeters');
@@ -1129,6 +1127,9 @@
             if (Number.isInteger(settings.rightAudioChannel)) {
                 rightSelect.value = String(settings.rightAudioChannel);
             }
+            if (layoutSelect && typeof settings.loudnessLayout === 'string') {
+                layoutSelect.value = settings.loudnessLayout;
+            }
             if (Number.isInteger(settings.device)) {
                 deviceSelect.value = String(settings.device);
             }
@@ -1183,6 +1184,9 @@
                 rightChannel: rightSelect.value,
                 device: deviceSelect.value
             };
+            if (layoutSelect) {
+                payload.layout = layoutSelect.value;
+            }
             fetch('/api/settings', {
                 method: 'POST',
                 headers: { 'Content-Type': 'application/json' },
@@ -1190,7 +1194,7 @@
             })
                 .then(res => res.json())
                 .then(() => {
-                    alert('채널 설정을 저장하고 캡처를 재시작했습니다.');
+                    alert('채널 설정을 저장했습니다.');
                     hidePanel();
                 })
                 .catch(err => {
@@ -1903,7 +1907,7 @@
 
     function setupWebSocket() {
         const ws = new WebSocket(`ws://${window.location.host}/?role=sub&page=audio`);
-        ws.binaryType = 'blob';
+        ws.binaryType = 'arraybuffer';
         socketController.ws = ws;
 
         ws.onopen = () => {
@@ -1913,6 +1917,10 @@
 
         ws.onmessage = event => {
             if (typeof event.data !== 'string') {
+                if (window.SdiTelemetry && SdiTelemetry.isFrame(event.data)) {
+                    SdiTelemetry.decodeFrame(event.data).forEach(handleMessage);
+                    return;
+                }
                 const blob = event.data instanceof Blob ? event.data : new Blob([event.data], { type: 'image/jpeg' });
                 dataBus.publish('vectorscope_frame', blob);
                 return;
@@ -1925,7 +1933,10 @@
                 console.error('Failed to parse message', err);
                 return;
             }
+            handleMessage(data);
+        };
 
+        function handleMessage(data) {
             switch (data.type) {
                 case 'levels':
                     updateLevelState(data);
@@ -1960,13 +1971,23 @@
                 case 'lra':
                     dataBus.publish('lra', data);
                     break;
+                case 'pair_loudness':
+                    dataBus.publish('pair_loudness', data.pairs);
+                    break;
+                case 'capture_stats':
+                    dataBus.publish('capture_stats', data);
+                    break;
                 case 'settings':
                     dataBus.publish('settings', data);
                     break;
+                case 'configure_error':
+                    console.warn('Capture rejected the new settings:', data.message);
+                    dataBus.publish('configure_error', data);
+                    break;
                 default:
                     break;
             }
-        };
+        }
 
         ws.onerror = err => {
             console.error('WebSocket error', err);
@@ -1996,6 +2017,9 @@
                 animationState.multiPpm.latestValues[idx] = Number.isFinite(db) ? db : MIN_DB;
             });
         }
+        if (Array.isArray(data.true_peak)) {
+            dataBus.publish('true_peak', { peak: data.true_peak, hold: data.true_peak_hold });
+        }
     }
 
     function updateLkfsState(key, value) {
@@ -2012,10 +2036,21 @@
         }
     }
 
+    function createEqBands(count) {
+        return Array.from({ length: count }, () => ({
+            latestValue: MIN_DB_EQ,
+            displayValue: MIN_DB_EQ
+        }));
+    }
+
     function updateEqState(bands) {
         if (!Array.isArray(bands)) return;
+        // Capture decides the band layout (-b); follow whatever count it sends.
+        if (bands.length > 0 && bands.length !== animationState.eq.bands.length) {
+            animationState.eq.bands = createEqBands(bands.length);
+        }
         const stateBands = animationState.eq.bands;
-        for (let i = 0; i < NUM_EQ_BANDS; i++) {
+        for (let i = 0; i < stateBands.length; i++) {
             if (bands[i] !== undefined) {
                 const value = clamp(bands[i], MIN_DB_EQ, MAX_DB_EQ);
                 stateBands[i].latestValue = value;
@@ -2113,7 +2148,7 @@
 
     function updateEq(deltaSeconds) {
         const bands = animationState.eq.bands;
-        for (let i = 0; i < NUM_EQ_BANDS; i++) {
+        for (let i = 0; i < bands.length; i++) {
             const band = bands[i];
             if (band.latestValue > band.displayValue) band.displayValue = band.latestValue;
             else band.displayValue = Math.max(band.displayValue - FALL_RATE * deltaSeconds, MIN_DB_EQ);
@@ -2136,8 +2171,9 @@
         ctx.fillRect(0, 0, canvas.width, canvas.height);
         ctx.translate(axisYWidth, 0);
 
-        const barWidth = meterWidth / NUM_EQ_BANDS;
-        for (let i = 0; i < NUM_EQ_BANDS; i++) {
+        const bandCount = animationState.eq.bands.length;
+        const barWidth = meterWidth / bandCount;
+        for (let i = 0; i < bandCount; i++) {
             const db = animationState.eq.bands[i].displayValue;
             const percent = (db - MIN_DB_EQ) / (MAX_DB_EQ - MIN_DB_EQ);
             const barHeight = Math.max(0, meterHeight * percent);
@@ -0,0 +1,142 @@
+// Decoder for the binary audio telemetry frames written by include/telemetry_frame.h.
+//
+// decodeFrame() turns one frame into the same message objects the JSON protocol used
+// ({ type: 'levels', ... }, { type: 'lkfs', value }, ...), so pages can keep a single
+// message handler for both.
+(function (global) {
+    const MAGIC = 0x544D4C53; // "SLMT"
+    const VERSION = 1;
+    const HEADER_SIZE = 12;
+    const SECTION_HEADER_SIZE = 8;
+
+    const FLOAT32 = 1;
+    const INT16 = 2;
+
+    const SECTION = {
+        LEVELS: 1,
+        TRUE_PEAK: 2,
+        TRUE_PEAK_HOLD: 3,
+        LOUDNESS: 4,
+        PAIR_LOUDNESS: 5,
+        CORRELATION: 6,
+        EQ: 7,
+        VECTORSCOPE: 8,
+        CHANNEL_SPECTRUM: 9,
+        CORRELATION_MATRIX: 10
+    };
+
+    function isFrame(buffer) {
+        if (!(buffer instanceof ArrayBuffer) || buffer.byteLength < HEADER_SIZE) return false;
+        return new DataView(buffer).getUint32(0, true) === MAGIC;
+    }
+
+    function readSections(buffer) {
+        const view = new DataView(buffer);
+        const sections = new Map();
+        if (view.getUint16(4, true) !== VERSION) return sections;
+
+        const count = view.getUint16(6, true);
+        let offset = HEADER_SIZE;
+        for (let i = 0; i < count && offset + SECTION_HEADER_SIZE <= buffer.byteLength; i++) {
+            const id = view.getUint16(offset, true);
+            const type = view.getUint8(offset + 2);
+            const length = view.getUint32(offset + 4, true);
+            const start = offset + SECTION_HEADER_SIZE;
+            const elementSize = type === INT16 ? 2 : 4;
+            if (start + length * elementSize > buffer.byteLength) break;
+
+            if (type === FLOAT32) {
+                sections.set(id, new Float32Array(buffer, start, length));
+            } else if (type === INT16) {
+                sections.set(id, new Int16Array(buffer, start, length));
+            }
+            offset = start + ((length * elementSize + 3) & ~3);
+        }
+        return sections;
+    }
+
+    // NaN marks a value the meter hasn't produced yet.
+    function present(value) {
+        return !Number.isNaN(value);
+    }
+
+    function decodeFrame(buffer) {
+        const messages = [];
+        if (!isFrame(buffer)) return messages;
+        const sections = readSections(buffer);
+
+        const levels = sections.get(SECTION.LEVELS);
+        if (levels && levels.length >= 2) {
+            const message = { type: 'levels', left: levels[0], right: levels[1], all: Array.from(levels.subarray(2)) };
+            const truePeak = sections.get(SECTION.TRUE_PEAK);
+            if (truePeak) message.true_peak = Array.from(truePeak);
+            const truePeakHold = sections.get(SECTION.TRUE_PEAK_HOLD);
+            if (truePeakHold) message.true_peak_hold = Array.from(truePeakHold);
+            messages.push(message);
+        }
+
+        const loudness = sections.get(SECTION.LOUDNESS);
+        if (loudness) {
+            for (let i = 0; i + 4 <= loudness.length; i += 4) {
+                messages.push({ type: 'lkfs', value: loudness[i] });
+                if (present(loudness[i + 2])) messages.push({ type: 'i_lkfs', value: loudness[i + 2] });
+                if (present(loudness[i + 1])) messages.push({ type: 's_lkfs', value: loudness[i + 1] });
+                if (present(loudness[i + 3])) messages.push({ type: 'lra', value: loudness[i + 3] });
+            }
+        }
+
+        const pairLoudness = sections.get(SECTION.PAIR_LOUDNESS);
+        if (pairLoudness) {
+            const pairs = [];
+            for (let i = 0; i + 6 <= pairLoudness.length; i += 6) {
+                const pair = { left: pairLoudness[i], right: pairLoudness[i + 1] };
+                if (present(pairLoudness[i + 2])) pair.m = pairLoudness[i + 2];
+                if (present(pairLoudness[i + 3])) pair.s = pairLoudness[i + 3];
+                if (present(pairLoudness[i + 4])) pair.i = pairLoudness[i + 4];
+                if (present(pairLoudness[i + 5])) pair.lra = pairLoudness[i + 5];
+                pairs.push(pair);
+            }
+            messages.push({ type: 'pair_loudness', pairs });
+        }
+
+        const vectorscope = sections.get(SECTION.VECTORSCOPE);
+        if (vectorscope) {
+            const samples = new Array(vectorscope.length >> 1);
+            for (let i = 0; i < samples.length; i++) {
+                samples[i] = [vectorscope[2 * i] / 32767, vectorscope[2 * i + 1] / 32767];
+            }
+            messages.push({ type: 'vectorscope_samples', samples });
+        }
+
+        const correlation = sections.get(SECTION.CORRELATION);
+        if (correlation && correlation.length > 0) {
+            messages.push({ type: 'correlation', value: correlation[0] });
+        }
+
+        const correlationMatrix = sections.get(SECTION.CORRELATION_MATRIX);
+        if (correlationMatrix) {
+            // n channels give n * (n - 1) / 2 pairs.
+            const channels = Math.round((1 + Math.sqrt(1 + 8 * correlationMatrix.length)) / 2);
+            messages.push({ type: 'correlation_matrix', channels, values: Array.from(correlationMatrix) });
+        }
+
+        const eq = sections.get(SECTION.EQ);
+        if (eq) {
+            messages.push({ type: 'eq', data: Array.from(eq) });
+        }
+
+        const channelSpectrum = sections.get(SECTION.CHANNEL_SPECTRUM);
+        if (channelSpectrum && channelSpectrum.length > 0 && channelSpectrum[0] > 0) {
+            const bandCount = channelSpectrum[0];
+            const channels = [];
+            for (let start = 1; start + bandCount <= channelSpectrum.length; start += bandCount) {
+                channels.push(Array.from(channelSpectrum.subarray(start, start + bandCount), value => value / 100));
+            }
+            messages.push({ type: 'channel_spectrum', channels });
+        }
+
+        return messages;
+    }
+
+    global.SdiTelemetry = { isFrame, decodeFrame };
+})(window);